@@ -0,0 +1,180 @@
+#! /usr/bin/env python3
+"""Measure how the phases of dtiger scale with the size of the program.
+
+Every parameter of gen_program.py is swept in turn, the others keeping
+their default value. For each generated program, each phase is run a
+few times and the best user+system time and the peak resident memory
+are recorded. The cost of compiling an empty program, which is mostly
+process startup, is subtracted from both.
+
+For each parameter and phase, the exponent of the growth is estimated
+by a least-squares fit in log-log scale. An exponent above the threshold
+is flagged as super-linear, and makes the harness fail with
+--fail-on-superlinear.
+"""
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+
+sys.dont_write_bytecode = True
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import gen_program  # noqa: E402
+
+# Each phase stops the driver after it, so that the later ones also
+# include the cost of the earlier ones.
+PHASES = [
+    ("parse", []),
+    ("bind", ["-b"]),
+    ("type", ["-t"]),
+    ("irgen", ["-i"]),
+    ("obj-O0", ["-i", "--emit-obj", "-O0", "-o", os.devnull]),
+]
+
+# Sizes swept for each parameter, the other ones keeping their default.
+SWEEPS = [
+    ("functions", [250, 500, 1000, 2000], {}),
+    ("shadowed", [250, 500, 1000, 2000], {"shadow": True}),
+    ("depth", [8, 16, 32, 64], {}),
+    ("sequence", [2000, 4000, 8000, 16000], {}),
+    ("variables", [100, 200, 400, 800], {}),
+    ("chain", [100, 200, 400, 800], {}),
+    ("strings", [2000, 4000, 8000, 16000], {}),
+]
+
+# Below these net costs, measurements are too noisy to be fitted.
+MIN_SECONDS = 0.05
+MIN_KILOBYTES = 4096
+
+
+def run(dtiger, flags, program, repeat):
+    """Return the best time in seconds and peak memory in kilobytes."""
+    best_time, best_rss = math.inf, math.inf
+    for _ in range(repeat):
+        with open(os.devnull, "w") as devnull:
+            process = subprocess.Popen([dtiger] + flags + [program],
+                                       stdout=devnull)
+            _, status, usage = os.wait4(process.pid, 0)
+        if status != 0:
+            sys.exit("%s failed on %s" % (" ".join([dtiger] + flags), program))
+        best_time = min(best_time, usage.ru_utime + usage.ru_stime)
+        best_rss = min(best_rss, usage.ru_maxrss)
+    return best_time, best_rss
+
+
+def exponent(sizes, costs):
+    """Return the slope of the least-squares fit of log(cost) on log(size)."""
+    points = [(math.log(size), math.log(cost))
+              for size, cost in zip(sizes, costs) if cost > 0]
+    if len(points) < 2:
+        return None
+    mean_x = sum(x for x, _ in points) / len(points)
+    mean_y = sum(y for _, y in points) / len(points)
+    num = sum((x - mean_x) * (y - mean_y) for x, y in points)
+    den = sum((x - mean_x) ** 2 for x, _ in points)
+    return num / den
+
+
+def parameters(overrides):
+    parser = argparse.ArgumentParser()
+    gen_program.add_arguments(parser)
+    params = parser.parse_args([])
+    for key, value in overrides.items():
+        setattr(params, key, value)
+    return params
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--dtiger", default="src/driver/dtiger",
+                        help="compiler to measure")
+    parser.add_argument("--repeat", type=int, default=3,
+                        help="number of runs of each measurement")
+    parser.add_argument("--scale", type=float, default=1.0,
+                        help="factor applied to every swept size")
+    parser.add_argument("--threshold", type=float, default=1.3,
+                        help="growth exponent flagged as super-linear")
+    parser.add_argument("--only", action="append", metavar="PARAMETER",
+                        help="only sweep this parameter")
+    parser.add_argument("--json", metavar="FILE",
+                        help="write the measurements to this file")
+    parser.add_argument("--fail-on-superlinear", action="store_true",
+                        help="exit with an error if any growth is flagged")
+    args = parser.parse_args()
+
+    workdir = tempfile.mkdtemp(prefix="bench-compiler-")
+    empty = os.path.join(workdir, "empty.tig")
+    with open(empty, "w") as f:
+        f.write("0\n")
+    baseline = {name: run(args.dtiger, flags, empty, args.repeat)
+                for name, flags in PHASES}
+
+    results, flagged = [], []
+    for parameter, sizes, extra in SWEEPS:
+        if args.only and parameter not in args.only:
+            continue
+        sizes = [max(1, int(size * args.scale)) for size in sizes]
+        key = "functions" if parameter == "shadowed" else parameter
+        measures = {name: [] for name, _ in PHASES}
+        for size in sizes:
+            program = os.path.join(workdir, "%s-%d.tig" % (parameter, size))
+            with open(program, "w") as f:
+                f.write(gen_program.generate(
+                    parameters(dict(extra, **{key: size}))))
+            for name, flags in PHASES:
+                measures[name].append(
+                    run(args.dtiger, flags, program, args.repeat))
+            os.unlink(program)
+
+        print("%s: %s" % (parameter, " ".join(map(str, sizes))))
+        for name, _ in PHASES:
+            times = [max(0.0, t - baseline[name][0])
+                     for t, _ in measures[name]]
+            memory = [max(0, rss - baseline[name][1])
+                      for _, rss in measures[name]]
+            time_exp = exponent(sizes, times) \
+                if times[-1] >= MIN_SECONDS else None
+            memory_exp = exponent(sizes, memory) \
+                if memory[-1] >= MIN_KILOBYTES else None
+            marks = []
+            if time_exp is not None and time_exp > args.threshold:
+                marks.append("time")
+            if memory_exp is not None and memory_exp > args.threshold:
+                marks.append("memory")
+            print("  %-8s time %s s ~n^%s  memory %s KiB ~n^%s%s" % (
+                name,
+                " ".join("%.3f" % t for t in times),
+                "-" if time_exp is None else "%.2f" % time_exp,
+                " ".join("%d" % m for m in memory),
+                "-" if memory_exp is None else "%.2f" % memory_exp,
+                "  SUPER-LINEAR (%s)" % ", ".join(marks) if marks else ""))
+            if marks:
+                flagged.append("%s/%s" % (parameter, name))
+            results.append({
+                "parameter": parameter, "phase": name, "sizes": sizes,
+                "seconds": times, "kilobytes": memory,
+                "time_exponent": time_exp, "memory_exponent": memory_exp,
+                "superlinear": marks,
+            })
+
+    os.unlink(empty)
+    os.rmdir(workdir)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"baseline": baseline, "results": results}, f,
+                      indent=2)
+    if flagged:
+        print("super-linear growth: %s" % ", ".join(flagged))
+        if args.fail_on_superlinear:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,115 @@
+#! /usr/bin/env python3
+"""Generate a synthetic Tiger program whose size is controlled by a few
+parameters, to measure how the compiler scales with each of them.
+
+The program declares a number of functions, each nesting inner
+functions down to a given depth. Every level declares variables
+initialized by chains of operators over the names in scope, so that
+inner functions access the variables of their enclosing functions.
+The main sequence calls the functions and prints string literals.
+"""
+
+import argparse
+import sys
+
+OPERATORS = ["+", "-", "*"]
+
+
+def chain(names, length, seed):
+    """Return an operator chain of the given length over names."""
+    terms = [names[(seed + i) % len(names)] if names else str(i + 1)
+             for i in range(length + 1)]
+    expr = terms[0]
+    for i, term in enumerate(terms[1:]):
+        expr += " %s %s" % (OPERATORS[(seed + i) % len(OPERATORS)], term)
+    return expr
+
+
+def body(params, level, scope, indent):
+    """Return the body of a function at the given nesting level."""
+    pad = "  " * indent
+    names = list(scope)
+    decls = []
+    for j in range(params.variables):
+        name = "l%dv%d" % (level, j)
+        decls.append("%svar %s := %s" %
+                     (pad, name, chain(names, params.chain, j)))
+        names.append(name)
+    if level < params.depth:
+        param = "y%d" % (level + 1)
+        decls.append("%sfunction g%d(%s: int): int =\n%s" %
+                     (pad, level + 1, param,
+                      body(params, level + 1, names + [param], indent + 1)))
+        result = "g%d(%s)" % (level + 1, names[-1])
+    else:
+        result = chain(names, params.chain, level)
+    return "%slet\n%s\n%sin\n%s  %s\n%send" % (
+        pad, "\n".join(decls), pad, pad, result, pad)
+
+
+def function(params, name, callee):
+    """Return the declaration of a function calling callee, if any."""
+    text = "function %s(x: int): int =\n%s" % (
+        name, body(params, 0, ["x", "g"], 2))
+    if callee:
+        text += " + %s(x - 1)" % callee
+    return text
+
+
+def generate(params):
+    """Return the text of a program for the given parameters."""
+    lines = ["let", "  var g := 0"]
+    sequence = []
+    if params.shadow:
+        # Every function gets its own let and the same name, so that
+        # the binder has to make their external names unique.
+        for i in range(params.functions):
+            sequence.append("(let %s in g := g + f(%d) end)" %
+                            (function(params, "f", None), i))
+        for i in range(params.sequence):
+            sequence.append("g := g + %d" % i)
+    else:
+        for i in range(params.functions):
+            lines.append("  " + function(params, "f%d" % i,
+                                         "f%d" % (i - 1) if i else None))
+        for i in range(params.sequence):
+            if params.functions:
+                sequence.append("g := g + f%d(%d)" %
+                                (i % params.functions, i))
+            else:
+                sequence.append("g := g + %d" % i)
+    for i in range(params.strings):
+        sequence.append('print("string %d\\n")' % i)
+    sequence.append("print_int(g)")
+    lines.append("in")
+    lines.append(";\n".join("  " + expr for expr in sequence))
+    lines.append("end")
+    return "\n".join(lines) + "\n"
+
+
+def add_arguments(parser):
+    parser.add_argument("--functions", type=int, default=10,
+                        help="number of functions")
+    parser.add_argument("--depth", type=int, default=2,
+                        help="nesting depth of inner functions")
+    parser.add_argument("--sequence", type=int, default=10,
+                        help="length of the main sequence")
+    parser.add_argument("--variables", type=int, default=4,
+                        help="number of variables per nesting level")
+    parser.add_argument("--chain", type=int, default=4,
+                        help="number of operators in each expression")
+    parser.add_argument("--strings", type=int, default=4,
+                        help="number of distinct string literals")
+    parser.add_argument("--shadow", action="store_true",
+                        help="declare every function in its own let "
+                        "with the same name")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    add_arguments(parser)
+    sys.stdout.write(generate(parser.parse_args()))
+
+
+if __name__ == "__main__":
+    main()
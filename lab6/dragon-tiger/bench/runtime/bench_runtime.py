@@ -0,0 +1,192 @@
+#! /usr/bin/env python3
+"""Measure the performance of the code generated by dtiger.
+
+Every workload of the workloads directory is a Tiger program, compiled
+with the compile script, and an equivalent C program, compiled with the
+C compiler. Both must print the same output. Each of them is then run
+several times through perf-run, which records the hardware counters
+and resource usage of the program, and the median of every measure is
+reported along with the ratio between the Tiger and C programs.
+
+The measures of the Tiger programs can be saved with --save-baseline.
+Later runs given this file with --baseline are compared to it, changes
+beyond the tolerance being reported, and make the harness fail with
+--fail-on-regression if any measure got worse.
+"""
+
+import argparse
+import glob
+import json
+import os
+import random
+import shlex
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+
+MEASURES = ["seconds", "user", "cycles", "instructions", "cache-misses",
+            "maxrss"]
+
+
+def text_input(size):
+    """Return reproducible lines of words and numbers of the given size."""
+    generator = random.Random(0)
+    words = ["tiger", "dragon", "Frame", "static", "link", "LLVM", "42",
+             "1997", "closure", "escape"]
+    lines, length = [], 0
+    while length < size:
+        line = " ".join(generator.choice(words)
+                        for _ in range(generator.randint(1, 12))) + "\n"
+        lines.append(line)
+        length += len(line)
+    return "".join(lines)
+
+
+# Standard input of the workloads reading it, the others get an empty
+# one.
+INPUTS = {
+    "chars": lambda: text_input(1 << 20),
+}
+
+
+def compile_tiger(args, source, workdir):
+    """Compile a Tiger program with the compile script."""
+    env = dict(os.environ)
+    if args.tiger_flags is not None:
+        env["TIGER_FLAGS"] = args.tiger_flags
+    subprocess.check_call([os.path.abspath(args.compile),
+                           os.path.abspath(source)], cwd=workdir, env=env)
+    return os.path.join(workdir, "a.out")
+
+
+def compile_c(args, source, workdir):
+    executable = os.path.join(workdir, "c.out")
+    subprocess.check_call(shlex.split(args.cc) + shlex.split(args.cflags) +
+                          ["-o", executable, source])
+    return executable
+
+
+def output(executable, input_file):
+    with open(input_file) as stdin:
+        return subprocess.run([executable], stdin=stdin,
+                              stdout=subprocess.PIPE, check=True).stdout
+
+
+def measure(args, executable, input_file, workdir):
+    """Return the median of each measure over the runs of a program."""
+    report = os.path.join(workdir, "perf-run.txt")
+    runs = {name: [] for name in MEASURES}
+    for _ in range(args.runs):
+        with open(input_file) as stdin, open(os.devnull, "w") as stdout:
+            subprocess.check_call([args.perf_run, report, executable],
+                                  stdin=stdin, stdout=stdout)
+        with open(report) as f:
+            for line in f:
+                name, value = line.split()
+                if name in runs and value != "-":
+                    runs[name].append(float(value))
+    return {name: statistics.median(values) if values else None
+            for name, values in runs.items()}
+
+
+def show(value):
+    if value is None:
+        return "-"
+    if value >= 1e6:
+        return "%.4g" % value
+    return "%.3f" % value if value < 100 else "%d" % value
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--compile", default="./compile",
+                        help="script compiling a Tiger program")
+    parser.add_argument("--tiger-flags",
+                        help="options of dtiger, given as TIGER_FLAGS")
+    parser.add_argument("--cc", default="cc",
+                        help="compiler of the C programs")
+    parser.add_argument("--cflags", default="-O2",
+                        help="options of the C compiler")
+    parser.add_argument("--perf-run", default="bench/runtime/perf-run",
+                        help="program measuring a run")
+    parser.add_argument("--workloads", default=os.path.join(here, "workloads"),
+                        help="directory of the workloads")
+    parser.add_argument("--runs", type=int, default=5,
+                        help="number of runs of each program")
+    parser.add_argument("--only", action="append", metavar="WORKLOAD",
+                        help="only run this workload")
+    parser.add_argument("--baseline", metavar="FILE",
+                        help="compare the Tiger programs to this baseline")
+    parser.add_argument("--save-baseline", metavar="FILE",
+                        help="save the measures of the Tiger programs")
+    parser.add_argument("--tolerance", type=float, default=0.05,
+                        help="relative change reported against the baseline")
+    parser.add_argument("--fail-on-regression", action="store_true",
+                        help="exit with an error if any measure got worse")
+    args = parser.parse_args()
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)["workloads"]
+
+    workdir = tempfile.mkdtemp(prefix="bench-runtime-")
+    results, regressions = {}, []
+    try:
+        for source in sorted(glob.glob(os.path.join(args.workloads, "*.tig"))):
+            name = os.path.splitext(os.path.basename(source))[0]
+            if args.only and name not in args.only:
+                continue
+            input_file = os.path.join(workdir, "input")
+            with open(input_file, "w") as f:
+                f.write(INPUTS[name]() if name in INPUTS else "")
+
+            tiger = compile_tiger(args, source, workdir)
+            c = compile_c(args, os.path.splitext(source)[0] + ".c", workdir)
+            if output(tiger, input_file) != output(c, input_file):
+                sys.exit("%s: the Tiger and C programs print different outputs"
+                         % name)
+
+            results[name] = measure(args, tiger, input_file, workdir)
+            native = measure(args, c, input_file, workdir)
+            print("%s\n  %-13s %10s %10s %8s %10s %8s" % (
+                name, "measure", "tiger", "c", "tiger/c", "baseline",
+                "change"))
+            for key in MEASURES:
+                value = results[name][key]
+                reference = native[key]
+                before = baseline.get(name, {}).get(key)
+                ratio = change = mark = ""
+                if value is not None and reference:
+                    ratio = "%.2fx" % (value / reference)
+                if value is not None and before:
+                    relative = (value - before) / before
+                    change = "%+.1f%%" % (100 * relative)
+                    if relative > args.tolerance:
+                        mark = "  REGRESSION"
+                        regressions.append("%s/%s" % (name, key))
+                    elif relative < -args.tolerance:
+                        mark = "  improvement"
+                print("  %-13s %10s %10s %8s %10s %8s%s" % (
+                    key, show(value), show(reference), ratio, show(before),
+                    change, mark))
+    finally:
+        shutil.rmtree(workdir)
+
+    if args.save_baseline:
+        with open(args.save_baseline, "w") as f:
+            json.dump({"tiger_flags": args.tiger_flags, "workloads": results},
+                      f, indent=2, sort_keys=True)
+    if regressions:
+        print("regressions: %s" % ", ".join(regressions))
+        if args.fail_on_regression:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+/* Run a program and report its hardware counters and resource usage.
+ *
+ * Usage: perf-run OUTPUT PROGRAM [ARGUMENT...]
+ *
+ * The program inherits the standard streams. Once it has exited, one
+ * "name value" line per measure is written to OUTPUT: the elapsed,
+ * user and system times in seconds, the peak resident set size in
+ * kilobytes, the exit status, and the user-space cycles, instructions
+ * and cache misses counted with perf_event_open. Counters which cannot
+ * be opened, for instance in a virtual machine or with a restrictive
+ * perf_event_paranoid, are reported as "-". */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static const struct {
+  const char *name;
+  uint64_t config;
+} counters[] = {
+  {"cycles", PERF_COUNT_HW_CPU_CYCLES},
+  {"instructions", PERF_COUNT_HW_INSTRUCTIONS},
+  {"cache-misses", PERF_COUNT_HW_CACHE_MISSES},
+};
+
+#define NCOUNTERS (sizeof(counters) / sizeof(counters[0]))
+
+__attribute__((noreturn))
+static void error(const char *msg) {
+  perror(msg);
+  exit(EXIT_FAILURE);
+}
+
+/* Opens a counter of the given child, started when it executes the
+ * program. Returns -1 if the counter is not available. */
+static int open_counter(pid_t pid, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.enable_on_exec = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+    PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+/* Reads a counter, scaled up if it has been multiplexed with others. */
+static int read_counter(int fd, uint64_t *value) {
+  uint64_t values[3];
+  if (fd < 0 || read(fd, values, sizeof(values)) != sizeof(values) ||
+      values[2] == 0) {
+    return 0;
+  }
+  *value = values[2] < values[1]
+    ? (uint64_t) ((double) values[0] * values[1] / values[2])
+    : values[0];
+  return 1;
+}
+
+static double seconds(const struct timeval *tv) {
+  return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s OUTPUT PROGRAM [ARGUMENT...]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  FILE *output = fopen(argv[1], "w");
+  if (!output) {
+    error(argv[1]);
+  }
+
+  /* The child waits for its counters to be opened before executing
+     the program, which enables them. */
+  int go[2];
+  if (pipe(go) != 0) {
+    error("pipe");
+  }
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pid_t pid = fork();
+  if (pid < 0) {
+    error("fork");
+  }
+  if (pid == 0) {
+    char c;
+    close(go[1]);
+    if (read(go[0], &c, 1) != 1) {
+      _exit(EXIT_FAILURE);
+    }
+    execvp(argv[2], &argv[2]);
+    perror(argv[2]);
+    _exit(127);
+  }
+
+  close(go[0]);
+  int fds[NCOUNTERS];
+  for (size_t i = 0; i < NCOUNTERS; i++) {
+    fds[i] = open_counter(pid, counters[i].config);
+  }
+  if (write(go[1], "", 1) != 1) {
+    error("write");
+  }
+  close(go[1]);
+
+  int status;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) < 0) {
+    if (errno != EINTR) {
+      error("wait4");
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  fprintf(output, "seconds %.6f\n",
+          (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+  fprintf(output, "user %.6f\n", seconds(&usage.ru_utime));
+  fprintf(output, "system %.6f\n", seconds(&usage.ru_stime));
+  fprintf(output, "maxrss %ld\n", usage.ru_maxrss);
+  fprintf(output, "status %d\n",
+          WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+  for (size_t i = 0; i < NCOUNTERS; i++) {
+    uint64_t value;
+    if (read_counter(fds[i], &value)) {
+      fprintf(output, "%s %llu\n", counters[i].name, (unsigned long long) value);
+    } else {
+      fprintf(output, "%s -\n", counters[i].name);
+    }
+  }
+  fclose(output);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
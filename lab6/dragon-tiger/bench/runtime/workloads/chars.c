@@ -0,0 +1,27 @@
+/* Character processing: copies the standard input with its lowercase
+   letters in uppercase, and counts its letters, digits, spaces and
+   lines. */
+#include <stdio.h>
+
+int main(void) {
+  int letters = 0, digits = 0, spaces = 0, lines = 0, hash = 0, c;
+  while ((c = getchar()) != EOF) {
+    if (c >= 'a' && c <= 'z') {
+      letters++;
+      putchar(c - 32);
+    } else {
+      if (c >= 'A' && c <= 'Z')
+        letters++;
+      else if (c >= '0' && c <= '9')
+        digits++;
+      else if (c == ' ')
+        spaces++;
+      else if (c == '\n')
+        lines++;
+      putchar(c);
+    }
+    hash = (hash * 31 + c) % 1000003;
+  }
+  printf("%d %d %d %d %d\n", letters, digits, spaces, lines, hash);
+  return 0;
+}
@@ -0,0 +1,35 @@
+/* Nested functions reading and updating the variables of their
+   enclosing functions, passed by address. */
+#include <stdio.h>
+
+static int total;
+
+static void level4(int *x, int *y, int c, int d) {
+  total = (total + *x * d - *y) % 1000003;
+  *x += 1;
+  *y -= c;
+}
+
+static void level3(int *x, int *y, int c) {
+  for (int d = 1; d <= 10; d++)
+    level4(x, y, c, d);
+}
+
+static void level2(int *x, int b) {
+  int y = b;
+  for (int c = 1; c <= 10; c++)
+    level3(x, &y, c);
+}
+
+static void level1(int a) {
+  int x = a;
+  for (int b = 1; b <= 10; b++)
+    level2(&x, b);
+}
+
+int main(void) {
+  for (int a = 1; a <= 20000; a++)
+    level1(a);
+  printf("%d\n", total);
+  return 0;
+}
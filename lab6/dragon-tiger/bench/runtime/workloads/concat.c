@@ -0,0 +1,18 @@
+/* String building: strings grown one character at a time with concat,
+   then restarted. */
+#include <stdio.h>
+
+int main(void) {
+  char s[101];
+  int length = 0, total = 0;
+  for (int i = 1; i <= 200000; i++) {
+    s[length++] = 'a' + i % 26;
+    if (length == 100) {
+      total += length;
+      length = 0;
+    }
+  }
+  s[length] = '\0';
+  printf("%d\n%s\n", total + length, s);
+  return 0;
+}
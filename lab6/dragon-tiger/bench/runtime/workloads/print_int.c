@@ -0,0 +1,8 @@
+/* Output: formats and prints many integers. */
+#include <stdio.h>
+
+int main(void) {
+  for (int i = 0; i <= 1000000; i++)
+    printf("%d\n", i * 7 - 3500000);
+  return 0;
+}
@@ -14,6 +14,17 @@ char const * const get_type_name(ast::Type t) {
   }
 }
 
+std::string get_effects_name(unsigned effects) {
+  if (!effects)
+    return "pure";
+  std::string name;
+  const char *const names[] = {"reads", "writes", "io", "diverges"};
+  for (unsigned i = 0; i < 4; i++)
+    if (effects & (1 << i))
+      name += std::string(name.empty() ? "" : ",") + names[i];
+  return name;
+}
+
 } // namespace
 
 
@@ -154,6 +165,8 @@ void ASTDumper::visit(const FunDecl &decl) {
   *ostream << "function " << decl.name;
   if (verbose && decl.name != decl.get_external_name())
     *ostream << "/*" << decl.get_external_name() << "*/";
+  if (verbose && decl.get_effects() != e_all)
+    *ostream << "/*" << get_effects_name(decl.get_effects()) << "*/";
   *ostream << '(';
   auto params = decl.get_params();
   for (auto param = params.cbegin(); param != params.cend(); param++) {
@@ -1,6 +1,5 @@
-#include <sstream>
-
 #include "binder.hh"
+#include "primitives.hh"
 #include "../utils/errors.hh"
 #include "../utils/nolocation.hh"
 
@@ -50,42 +49,8 @@ Binder::Binder() : scopes() {
   push_scope();
 
   /* Populate the top-level scope with all the primitive declarations */
-  const Symbol s_int = Symbol("int");
-  const Symbol s_string = Symbol("string");
-  enter_primitive("print_err", boost::none, {s_string});
-  enter_primitive("print", boost::none, {s_string});
-  enter_primitive("print_int", boost::none, {s_int});
-  enter_primitive("flush", boost::none, {});
-  enter_primitive("getchar", s_string, {});
-  enter_primitive("ord", s_int, {s_string});
-  enter_primitive("chr", s_string, {s_int});
-  enter_primitive("size", s_int, {s_string});
-  enter_primitive("substring", s_string, {s_string, s_int, s_int});
-  enter_primitive("concat", s_string, {s_string, s_string});
-  enter_primitive("strcmp", s_int, {s_string, s_string});
-  enter_primitive("streq", s_int, {s_string, s_string});
-  enter_primitive("not", s_int, {s_int});
-  enter_primitive("exit", boost::none, {s_int});
-}
-
-/* Declares a new primitive into the current scope*/
-void Binder::enter_primitive(
-    const std::string &name, const boost::optional<Symbol> &type_name,
-    const std::vector<Symbol> &argument_typenames) {
-  std::vector<VarDecl *> args;
-  int counter = 0;
-  for (const Symbol &tn : argument_typenames) {
-    std::ostringstream argname;
-    argname << "a_" << counter++;
-    args.push_back(
-        new VarDecl(utils::nl, Symbol(argname.str()), nullptr, tn));
-  }
-
-  boost::optional<Symbol> type_name_symbol = boost::none;
-  FunDecl *fd = new FunDecl(utils::nl, Symbol(name), std::move(args), nullptr,
-                            type_name, true);
-  fd->set_external_name(Symbol("__" + name));
-  enter(*fd);
+  for (auto &primitive : primitives::all())
+    enter(*primitives::make_declaration(primitive));
 }
 
 /* Sets the parent of a function declaration and computes and sets
@@ -126,6 +91,12 @@ FunDecl *Binder::analyze_program(Expr &root) {
   return main;
 }
 
+/* Returns the declaration of a primitive, shared by all the calls to it. It
+ * is not part of the AST and lives until the end of the compilation. */
+FunDecl &Binder::primitive(const Symbol &name) {
+  return dynamic_cast<FunDecl &>(*scopes.front().at(name));
+}
+
 
 void Binder::visit(IntegerLiteral &literal) {
 }
@@ -215,6 +186,11 @@ void Binder::visit(FunDecl &decl) {
   /* ... put your code here ... */
   decl.set_depth(functions.size() - 1);
 
+  // A break cannot leave the function body for a loop enclosing the
+  // declaration.
+  std::vector<Loop *> outer_loops;
+  outer_loops.swap(loops);
+
   push_scope();
   for (auto param : decl.get_params()) {
     param->accept(*this);
@@ -222,6 +198,7 @@ void Binder::visit(FunDecl &decl) {
   decl.get_expr()->accept(*this);
   pop_scope();
 
+  loops.swap(outer_loops);
   functions.pop_back();
 }
 
@@ -23,14 +23,13 @@ class Binder : public ASTVisitor {
   scope_t &current_scope();
   void enter(Decl &);
   Decl &find(const location loc, const Symbol &name);
-  void enter_primitive(const std::string &, const boost::optional<Symbol> &,
-                       const std::vector<Symbol> &);
   void set_parent_and_external_name(FunDecl &decl);
   bool is_loop_index(VarDecl*);
 
 public:
   Binder();
   FunDecl *analyze_program(Expr &);
+  FunDecl &primitive(const Symbol &name);
   virtual void visit(IntegerLiteral &);
   virtual void visit(StringLiteral &);
   virtual void visit(BinaryOperator &);
@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <functional>
+
+#include "callgraph.hh"
+
+namespace ast {
+namespace callgraph {
+
+/* Returns the node index of a function, creating the node on first use */
+unsigned CallGraph::node(const FunDecl &decl) {
+  auto entry = index.find(&decl);
+  if (entry != index.end())
+    return entry->second;
+  unsigned n = nodes.size();
+  index[&decl] = n;
+  nodes.push_back(Node());
+  nodes.back().decl = &decl;
+  return n;
+}
+
+const CallGraph::Node &CallGraph::find(const FunDecl &decl) const {
+  auto entry = index.find(&decl);
+  assert(entry != index.end());
+  return nodes[entry->second];
+}
+
+/* Builds the graph of a whole program and runs all the analyses on it */
+void CallGraph::analyze(const FunDecl &main) {
+  main.accept(*this);
+  compute_edges();
+  compute_components();
+  compute_reachability();
+}
+
+/* Groups call sites by callee, keeping the order of first appearance */
+void CallGraph::compute_edges() {
+  for (unsigned n = 0; n < nodes.size(); n++) {
+    for (auto site : nodes[n].sites) {
+      unsigned callee = index[&site->get_decl().get()];
+      auto edge = std::find_if(
+          nodes[n].callees.begin(), nodes[n].callees.end(),
+          [callee](const std::pair<unsigned, unsigned> &e) {
+            return e.first == callee;
+          });
+      if (edge != nodes[n].callees.end()) {
+        edge->second++;
+        continue;
+      }
+      nodes[n].callees.push_back(std::make_pair(callee, 1));
+      nodes[callee].callers.push_back(n);
+    }
+  }
+}
+
+/* Tarjan's algorithm. Components are completed callees first. */
+void CallGraph::compute_components() {
+  const int unvisited = -1;
+  std::vector<int> number(nodes.size(), unvisited);
+  std::vector<int> low(nodes.size());
+  std::vector<bool> on_stack(nodes.size(), false);
+  std::vector<unsigned> stack;
+  int counter = 0;
+
+  std::function<void(unsigned)> connect = [&](unsigned n) {
+    number[n] = low[n] = counter++;
+    stack.push_back(n);
+    on_stack[n] = true;
+    for (auto edge : nodes[n].callees) {
+      unsigned m = edge.first;
+      if (number[m] == unvisited) {
+        connect(m);
+        low[n] = std::min(low[n], low[m]);
+      } else if (on_stack[m])
+        low[n] = std::min(low[n], number[m]);
+    }
+    if (low[n] != number[n])
+      return;
+    std::vector<const FunDecl *> component;
+    unsigned m;
+    do {
+      m = stack.back();
+      stack.pop_back();
+      on_stack[m] = false;
+      nodes[m].scc = components.size();
+      component.push_back(nodes[m].decl);
+    } while (m != n);
+    std::reverse(component.begin(), component.end());
+    components.push_back(component);
+  };
+
+  for (unsigned n = 0; n < nodes.size(); n++)
+    if (number[n] == unvisited)
+      connect(n);
+
+  // A function is recursive if it shares its component with another
+  // function or if it calls itself directly.
+  for (auto &n : nodes) {
+    n.recursive = components[n.scc].size() > 1;
+    for (auto edge : n.callees)
+      if (&nodes[edge.first] == &n)
+        n.recursive = true;
+  }
+}
+
+/* Marks every function reachable from main, which is the first node */
+void CallGraph::compute_reachability() {
+  if (nodes.empty())
+    return;
+  std::vector<unsigned> worklist({0});
+  nodes[0].reachable = true;
+  while (!worklist.empty()) {
+    unsigned n = worklist.back();
+    worklist.pop_back();
+    for (auto edge : nodes[n].callees) {
+      if (!nodes[edge.first].reachable) {
+        nodes[edge.first].reachable = true;
+        worklist.push_back(edge.first);
+      }
+    }
+  }
+}
+
+std::vector<const FunDecl *> CallGraph::functions() const {
+  std::vector<const FunDecl *> result;
+  for (auto &n : nodes)
+    result.push_back(n.decl);
+  return result;
+}
+
+std::vector<const FunDecl *> CallGraph::callees(const FunDecl &decl) const {
+  std::vector<const FunDecl *> result;
+  for (auto edge : find(decl).callees)
+    result.push_back(nodes[edge.first].decl);
+  return result;
+}
+
+std::vector<const FunDecl *> CallGraph::callers(const FunDecl &decl) const {
+  std::vector<const FunDecl *> result;
+  for (auto caller : find(decl).callers)
+    result.push_back(nodes[caller].decl);
+  return result;
+}
+
+const std::vector<const FunCall *> &
+CallGraph::call_sites(const FunDecl &decl) const {
+  return find(decl).sites;
+}
+
+unsigned CallGraph::call_count(const FunDecl &caller,
+                               const FunDecl &callee) const {
+  auto entry = index.find(&callee);
+  if (entry == index.end())
+    return 0;
+  for (auto edge : find(caller).callees)
+    if (edge.first == entry->second)
+      return edge.second;
+  return 0;
+}
+
+unsigned CallGraph::call_count(const FunDecl &decl) const {
+  unsigned count = 0;
+  for (auto caller : find(decl).callers)
+    count += call_count(*nodes[caller].decl, decl);
+  return count;
+}
+
+bool CallGraph::is_recursive(const FunDecl &decl) const {
+  return find(decl).recursive;
+}
+
+bool CallGraph::is_reachable(const FunDecl &decl) const {
+  return find(decl).reachable;
+}
+
+unsigned CallGraph::scc(const FunDecl &decl) const { return find(decl).scc; }
+
+/* Dumps the graph in Graphviz format. Primitives are drawn as boxes,
+ * recursive functions in bold and unreachable ones dashed. Dotted edges
+ * link nested functions to their parent. */
+void CallGraph::dump_dot(std::ostream *ostream) const {
+  *ostream << "digraph callgraph {" << std::endl;
+  for (unsigned n = 0; n < nodes.size(); n++) {
+    const Node &node = nodes[n];
+    *ostream << "  n" << n << " [label=\"" << node.decl->get_external_name()
+             << "\"";
+    if (!node.decl->get_expr())
+      *ostream << ", shape=box";
+    if (node.recursive)
+      *ostream << ", style=bold";
+    else if (!node.reachable)
+      *ostream << ", style=dashed";
+    *ostream << "];" << std::endl;
+  }
+  for (unsigned n = 0; n < nodes.size(); n++) {
+    for (auto edge : nodes[n].callees) {
+      *ostream << "  n" << n << " -> n" << edge.first;
+      if (edge.second > 1)
+        *ostream << " [label=\"" << edge.second << "\"]";
+      *ostream << ";" << std::endl;
+    }
+    if (auto parent = nodes[n].decl->get_parent())
+      *ostream << "  n" << n << " -> n" << index.at(&parent.get())
+               << " [style=dotted, arrowhead=none];" << std::endl;
+  }
+  *ostream << "}" << std::endl;
+}
+
+/* Dumps the graph and the analyses results as a JSON document */
+void CallGraph::dump_json(std::ostream *ostream) const {
+  *ostream << "{\"functions\": [";
+  for (unsigned n = 0; n < nodes.size(); n++) {
+    const Node &node = nodes[n];
+    if (n)
+      *ostream << ",";
+    *ostream << std::endl
+             << "  {\"name\": \"" << node.decl->name << "\", \"external_name\": \""
+             << node.decl->get_external_name() << "\", \"parent\": ";
+    if (auto parent = node.decl->get_parent())
+      *ostream << '"' << parent->get_external_name() << '"';
+    else
+      *ostream << "null";
+    *ostream << ", \"primitive\": " << (node.decl->get_expr() ? "false" : "true")
+             << ", \"recursive\": " << (node.recursive ? "true" : "false")
+             << ", \"reachable\": " << (node.reachable ? "true" : "false")
+             << ", \"scc\": " << node.scc << ", \"calls\": [";
+    for (auto edge = node.callees.cbegin(); edge != node.callees.cend(); edge++) {
+      if (edge != node.callees.cbegin())
+        *ostream << ", ";
+      *ostream << "{\"callee\": \"" << nodes[edge->first].decl->get_external_name()
+               << "\", \"sites\": " << edge->second << "}";
+    }
+    *ostream << "]}";
+  }
+  *ostream << std::endl << "]}" << std::endl;
+}
+
+void CallGraph::visit(const IntegerLiteral &literal) {}
+
+void CallGraph::visit(const StringLiteral &literal) {}
+
+void CallGraph::visit(const BinaryOperator &op) {
+  op.get_left().accept(*this);
+  op.get_right().accept(*this);
+}
+
+void CallGraph::visit(const Sequence &seq) {
+  for (auto expr : seq.get_exprs())
+    expr->accept(*this);
+}
+
+void CallGraph::visit(const Let &let) {
+  for (auto decl : let.get_decls())
+    decl->accept(*this);
+  let.get_sequence().accept(*this);
+}
+
+void CallGraph::visit(const Identifier &id) {}
+
+void CallGraph::visit(const IfThenElse &ite) {
+  ite.get_condition().accept(*this);
+  ite.get_then_part().accept(*this);
+  ite.get_else_part().accept(*this);
+}
+
+void CallGraph::visit(const VarDecl &decl) {
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+}
+
+void CallGraph::visit(const FunDecl &decl) {
+  current_function.push_back(node(decl));
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+  current_function.pop_back();
+}
+
+void CallGraph::visit(const FunCall &call) {
+  node(call.get_decl().get());
+  nodes[current_function.back()].sites.push_back(&call);
+  for (auto arg : call.get_args())
+    arg->accept(*this);
+}
+
+void CallGraph::visit(const WhileLoop &loop) {
+  loop.get_condition().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void CallGraph::visit(const ForLoop &loop) {
+  loop.get_variable().accept(*this);
+  loop.get_high().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void CallGraph::visit(const Break &brk) {}
+
+void CallGraph::visit(const Assign &assign) {
+  assign.get_rhs().accept(*this);
+}
+
+} // namespace callgraph
+} // namespace ast
@@ -0,0 +1,101 @@
+#ifndef CALLGRAPH_HH
+#define CALLGRAPH_HH
+
+#include <ostream>
+#include <unordered_map>
+#include <utility>
+
+#include "nodes.hh"
+
+namespace ast {
+namespace callgraph {
+
+// Call graph of a bound program. Nodes are the function declarations
+// (including the primitives which are actually called), and there is
+// an edge from a function to every function it calls directly from
+// its own body. Calls made by nested functions belong to them, not to
+// their parent.
+//
+// Strongly connected components are numbered in reverse topological
+// order: a component only calls components with a smaller or equal
+// number, so iterating over them in order visits callees first.
+class CallGraph : public ConstASTVisitor {
+  struct Node {
+    const FunDecl *decl;
+    // Call sites found in the body of this function.
+    std::vector<const FunCall *> sites;
+    // Called functions with the number of call sites for each of them.
+    std::vector<std::pair<unsigned, unsigned>> callees;
+    std::vector<unsigned> callers;
+    unsigned scc = 0;
+    bool recursive = false;
+    bool reachable = false;
+  };
+
+  std::vector<Node> nodes;
+  std::unordered_map<const FunDecl *, unsigned> index;
+  std::vector<std::vector<const FunDecl *>> components;
+  std::vector<unsigned> current_function;
+
+  unsigned node(const FunDecl &);
+  const Node &find(const FunDecl &) const;
+  void compute_edges();
+  void compute_components();
+  void compute_reachability();
+
+public:
+  CallGraph() {}
+  void analyze(const FunDecl &main);
+
+  // All the functions of the program, main first, in the order in
+  // which they were first encountered.
+  std::vector<const FunDecl *> functions() const;
+
+  // Functions called from, or calling, a given function.
+  std::vector<const FunDecl *> callees(const FunDecl &) const;
+  std::vector<const FunDecl *> callers(const FunDecl &) const;
+
+  // Call sites in the body of a function.
+  const std::vector<const FunCall *> &call_sites(const FunDecl &) const;
+
+  // Number of call sites from caller to callee.
+  unsigned call_count(const FunDecl &caller, const FunDecl &callee) const;
+
+  // Number of call sites targeting a function from anywhere.
+  unsigned call_count(const FunDecl &) const;
+
+  // Whether the function belongs to a cycle of the call graph.
+  bool is_recursive(const FunDecl &) const;
+
+  // Whether the function can be called, directly or not, from main.
+  bool is_reachable(const FunDecl &) const;
+
+  // Strongly connected components, callees first.
+  const std::vector<std::vector<const FunDecl *>> &sccs() const {
+    return components;
+  }
+  unsigned scc(const FunDecl &) const;
+
+  void dump_dot(std::ostream *) const;
+  void dump_json(std::ostream *) const;
+
+  virtual void visit(const IntegerLiteral &);
+  virtual void visit(const StringLiteral &);
+  virtual void visit(const BinaryOperator &);
+  virtual void visit(const Sequence &);
+  virtual void visit(const Let &);
+  virtual void visit(const Identifier &);
+  virtual void visit(const IfThenElse &);
+  virtual void visit(const VarDecl &);
+  virtual void visit(const FunDecl &);
+  virtual void visit(const FunCall &);
+  virtual void visit(const WhileLoop &);
+  virtual void visit(const ForLoop &);
+  virtual void visit(const Break &);
+  virtual void visit(const Assign &);
+};
+
+} // namespace callgraph
+} // namespace ast
+
+#endif // CALLGRAPH_HH
@@ -0,0 +1,354 @@
+#include <cstring>
+
+#include "constant_folder.hh"
+#include "effects.hh"
+#include "type_checker.hh"
+
+namespace ast {
+namespace constant_folder {
+
+namespace {
+
+IntegerLiteral *as_int(Expr &expr) {
+  return dynamic_cast<IntegerLiteral *>(&expr);
+}
+
+StringLiteral *as_string(Expr &expr) {
+  return dynamic_cast<StringLiteral *>(&expr);
+}
+
+Expr *make_int(const location &loc, int32_t value) {
+  Expr *literal = new IntegerLiteral(loc, value);
+  literal->set_type(t_int);
+  return literal;
+}
+
+Expr *make_string(const location &loc, const std::string &value) {
+  Expr *literal = new StringLiteral(loc, Symbol(value));
+  literal->set_type(t_string);
+  return literal;
+}
+
+Expr *make_void(const location &loc) {
+  Expr *seq = new Sequence(loc, std::vector<Expr *>());
+  seq->set_type(t_void);
+  return seq;
+}
+
+// Comparisons and logical operators always give 0 or 1.
+bool is_boolean(Operator op) { return op >= o_eq; }
+
+bool is_logical(Operator op) { return op == o_and || op == o_or; }
+
+/* Returns an expression giving 1 if expr is nonzero and 0 otherwise */
+Expr *make_boolean(Expr *expr) {
+  BinaryOperator *op = dynamic_cast<BinaryOperator *>(expr);
+  if (op && is_boolean(op->op))
+    return expr;
+  Expr *test = new BinaryOperator(expr->loc, expr, make_int(expr->loc, 0), o_neq);
+  test->set_type(t_int);
+  return test;
+}
+
+/* Computes an operation on two integers with the semantics of the
+ * generated code (wrapping arithmetic). Returns false if the operation
+ * would fail at runtime. */
+bool compute(Operator op, int32_t l, int32_t r, int32_t &value) {
+  switch (op) {
+  case o_plus:
+    value = static_cast<int32_t>(static_cast<uint32_t>(l) + static_cast<uint32_t>(r));
+    return true;
+  case o_minus:
+    value = static_cast<int32_t>(static_cast<uint32_t>(l) - static_cast<uint32_t>(r));
+    return true;
+  case o_times:
+    value = static_cast<int32_t>(static_cast<uint32_t>(l) * static_cast<uint32_t>(r));
+    return true;
+  case o_divide:
+    if (r == 0 || (l == INT32_MIN && r == -1))
+      return false;
+    value = l / r;
+    return true;
+  case o_eq: value = l == r; return true;
+  case o_neq: value = l != r; return true;
+  case o_lt: value = l < r; return true;
+  case o_le: value = l <= r; return true;
+  case o_gt: value = l > r; return true;
+  case o_ge: value = l >= r; return true;
+  case o_and: value = l && r; return true;
+  case o_or: value = l || r; return true;
+  default:
+    assert(false); __builtin_unreachable();
+  }
+}
+
+/* Evaluates a call to a primitive on literal arguments. Returns nullptr
+ * if the primitive is not pure, or if its result depends on the locale
+ * or the call would fail at runtime. */
+Expr *evaluate_primitive(const FunCall &call) {
+  const std::string &name = call.get_decl()->get_external_name().get();
+  const location &loc = call.loc;
+  std::vector<std::string> s;
+  std::vector<int32_t> i;
+  for (auto arg : call.get_args()) {
+    if (IntegerLiteral *literal = as_int(*arg))
+      i.push_back(literal->value);
+    else
+      s.push_back(as_string(*arg)->value.get());
+  }
+
+  if (name == "__size")
+    return make_int(loc, s[0].size());
+  if (name == "__concat")
+    return make_string(loc, s[0] + s[1]);
+  if (name == "__strcmp") {
+    int cmp = strcmp(s[0].c_str(), s[1].c_str());
+    return make_int(loc, cmp < 0 ? -1 : cmp > 0);
+  }
+  if (name == "__streq")
+    return make_int(loc, s[0] == s[1]);
+  if (name == "__not")
+    return make_int(loc, i[0] == 0);
+  if (name == "__substring" && i[0] >= 0 && i[1] >= 0 &&
+      static_cast<size_t>(i[0]) <= s[0].size() &&
+      s[0].size() - i[0] >= static_cast<size_t>(i[1]))
+    return make_string(loc, s[0].substr(i[0], i[1]));
+  // Only ASCII characters are encoded the same way in every locale.
+  if (name == "__ord" && s[0].empty())
+    return make_int(loc, -1);
+  if (name == "__ord" && static_cast<unsigned char>(s[0][0]) < 128)
+    return make_int(loc, s[0][0]);
+  if (name == "__chr" && i[0] >= 0 && i[0] < 128)
+    return make_string(loc, std::string(i[0] ? 1 : 0, i[0]));
+  return nullptr;
+}
+
+} // namespace
+
+/* Folds a whole program in place */
+void ConstantFolder::fold_program(FunDecl &main) {
+  // Calls to `print' may be introduced even if the program does not use
+  // it, in which case its declaration has not been analyzed yet.
+  if (print_decl.get_type() == t_undef) {
+    type_checker::TypeChecker checker;
+    print_decl.accept(checker);
+    print_decl.set_effects(
+        effects::primitive_effects(print_decl.get_external_name()));
+  }
+  main.accept(use_counter);
+  main.accept(*this);
+}
+
+/* Folds an expression and returns its replacement. The original
+ * expression is deleted if it has been replaced. */
+Expr *ConstantFolder::fold(Expr *expr) {
+  result = expr;
+  expr->accept(*this);
+  Expr *folded = result;
+
+  // Parenthesized expressions are sequences of one element.
+  Sequence *seq = dynamic_cast<Sequence *>(folded);
+  if (seq && seq->get_exprs().size() == 1) {
+    folded = seq->get_exprs().front();
+    seq->get_exprs().clear();
+  }
+
+  if (folded != expr)
+    delete expr;
+  if (seq && folded != seq && seq != expr)
+    delete seq;
+  return folded;
+}
+
+void ConstantFolder::visit(IntegerLiteral &literal) { result = &literal; }
+
+void ConstantFolder::visit(StringLiteral &literal) { result = &literal; }
+
+void ConstantFolder::visit(BinaryOperator &op) {
+  op.set_left(fold(&op.get_left()));
+  op.set_right(fold(&op.get_right()));
+  result = &op;
+
+  IntegerLiteral *il = as_int(op.get_left());
+  IntegerLiteral *ir = as_int(op.get_right());
+  int32_t value;
+  if (il && ir) {
+    if (compute(op.op, il->value, ir->value, value))
+      result = make_int(op.loc, value);
+    return;
+  }
+
+  // The right operand of a logical operator is evaluated only if the
+  // left one does not decide the result.
+  if (is_logical(op.op)) {
+    if (il && (il->value != 0) == (op.op == o_or)) {
+      result = make_int(op.loc, op.op == o_or);
+    } else if (il) {
+      result = make_boolean(&op.get_right());
+      op.set_right(nullptr);
+    } else if (ir && (ir->value != 0) == (op.op == o_and)) {
+      result = make_boolean(&op.get_left());
+      op.set_left(nullptr);
+    }
+    return;
+  }
+
+  StringLiteral *sl = as_string(op.get_left());
+  StringLiteral *sr = as_string(op.get_right());
+  if (sl && sr) {
+    int cmp = strcmp(sl->value.get().c_str(), sr->value.get().c_str());
+    cmp = cmp < 0 ? -1 : cmp > 0;
+    if (compute(op.op, cmp, 0, value))
+      result = make_int(op.loc, value);
+    return;
+  }
+
+  // Neutral elements
+  if (ir && ((ir->value == 0 && (op.op == o_plus || op.op == o_minus)) ||
+             (ir->value == 1 && (op.op == o_times || op.op == o_divide)))) {
+    result = &op.get_left();
+    op.set_left(nullptr);
+  } else if (il && ((il->value == 0 && op.op == o_plus) ||
+                    (il->value == 1 && op.op == o_times))) {
+    result = &op.get_right();
+    op.set_right(nullptr);
+  }
+}
+
+void ConstantFolder::visit(Sequence &seq) {
+  std::vector<Expr *> &exprs = seq.get_exprs();
+  std::vector<Expr *> folded;
+  for (unsigned i = 0; i < exprs.size(); i++) {
+    Expr *expr = fold(exprs[i]);
+    // Literals are useless unless they are the value of the sequence.
+    if (i + 1 < exprs.size() && (as_int(*expr) || as_string(*expr)))
+      delete expr;
+    else
+      folded.push_back(expr);
+  }
+  exprs = folded;
+  result = &seq;
+}
+
+void ConstantFolder::visit(Let &let) {
+  for (auto decl : let.get_decls())
+    decl->accept(*this);
+  let.get_sequence().accept(*this);
+  result = &let;
+}
+
+void ConstantFolder::visit(Identifier &id) {
+  result = &id;
+  auto constant = constants.find(&id.get_decl().get());
+  if (constant == constants.end())
+    return;
+  if (IntegerLiteral *literal = as_int(*constant->second))
+    result = make_int(id.loc, literal->value);
+  else
+    result = make_string(id.loc, as_string(*constant->second)->value);
+}
+
+void ConstantFolder::visit(IfThenElse &ite) {
+  ite.set_condition(fold(&ite.get_condition()));
+  ite.set_then_part(fold(&ite.get_then_part()));
+  ite.set_else_part(fold(&ite.get_else_part()));
+  result = &ite;
+
+  if (IntegerLiteral *condition = as_int(ite.get_condition())) {
+    if (condition->value) {
+      result = &ite.get_then_part();
+      ite.set_then_part(nullptr);
+    } else {
+      result = &ite.get_else_part();
+      ite.set_else_part(nullptr);
+    }
+    return;
+  }
+
+  // `if c then 1 else 0' is c itself if c is already a boolean, or
+  // `c <> 0' otherwise. `if c then 0 else 1' is `c = 0'.
+  IntegerLiteral *then_part = as_int(ite.get_then_part());
+  IntegerLiteral *else_part = as_int(ite.get_else_part());
+  if (!then_part || !else_part)
+    return;
+  Expr *condition = &ite.get_condition();
+  if (then_part->value == 1 && else_part->value == 0) {
+    ite.set_condition(nullptr);
+    result = make_boolean(condition);
+  } else if (then_part->value == 0 && else_part->value == 1) {
+    ite.set_condition(nullptr);
+    result = new BinaryOperator(ite.loc, condition, make_int(ite.loc, 0), o_eq);
+    result->set_type(t_int);
+  }
+}
+
+void ConstantFolder::visit(VarDecl &decl) {
+  if (auto expr = decl.get_expr()) {
+    decl.set_expr(fold(&expr.get()));
+    Expr &value = decl.get_expr().get();
+    if (!decl.read_only && !use_counter.writes(decl) &&
+        (as_int(value) || as_string(value)))
+      constants[&decl] = &value;
+  }
+}
+
+void ConstantFolder::visit(FunDecl &decl) {
+  if (auto expr = decl.get_expr())
+    decl.set_expr(fold(&expr.get()));
+}
+
+void ConstantFolder::visit(FunCall &call) {
+  for (auto &arg : call.get_args())
+    arg = fold(arg);
+  result = &call;
+
+  if (!call.get_decl()->is_external)
+    return;
+  for (auto arg : call.get_args())
+    if (!as_int(*arg) && !as_string(*arg))
+      return;
+
+  if (call.get_decl()->get_external_name() == Symbol("__print_int")) {
+    int32_t value = as_int(*call.get_args().front())->value;
+    FunCall *print = new FunCall(
+        call.loc, {make_string(call.loc, std::to_string(value))}, Symbol("print"));
+    print->set_decl(&print_decl);
+    print->set_depth(call.get_depth());
+    print->set_type(t_void);
+    result = print;
+  } else if (Expr *value = evaluate_primitive(call)) {
+    result = value;
+  }
+}
+
+void ConstantFolder::visit(WhileLoop &loop) {
+  loop.set_condition(fold(&loop.get_condition()));
+  loop.set_body(fold(&loop.get_body()));
+  result = &loop;
+
+  IntegerLiteral *condition = as_int(loop.get_condition());
+  if (condition && !condition->value)
+    result = make_void(loop.loc);
+}
+
+void ConstantFolder::visit(ForLoop &loop) {
+  loop.get_variable().accept(*this);
+  loop.set_high(fold(&loop.get_high()));
+  loop.set_body(fold(&loop.get_body()));
+  result = &loop;
+
+  IntegerLiteral *low = as_int(loop.get_variable().get_expr().get());
+  IntegerLiteral *high = as_int(loop.get_high());
+  if (low && high && low->value > high->value)
+    result = make_void(loop.loc);
+}
+
+void ConstantFolder::visit(Break &b) { result = &b; }
+
+void ConstantFolder::visit(Assign &assign) {
+  assign.set_rhs(fold(&assign.get_rhs()));
+  result = &assign;
+}
+
+} // namespace constant_folder
+} // namespace ast
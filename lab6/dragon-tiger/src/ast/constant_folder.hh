@@ -0,0 +1,56 @@
+#ifndef CONSTANT_FOLDER_HH
+#define CONSTANT_FOLDER_HH
+
+#include <unordered_map>
+
+#include "nodes.hh"
+#include "uses.hh"
+
+namespace ast {
+namespace constant_folder {
+
+// Constant folding and propagation on a typed AST. Operations on integer
+// literals and comparisons of string literals are computed, conditionals
+// with a constant condition are replaced by the selected branch, and
+// `if c then 1 else 0' is turned into a comparison. Calls to pure
+// primitives on literals are evaluated, and `print_int' of a literal
+// becomes `print' of a string literal. Variables which are never assigned
+// and whose initial value is a literal are replaced by this literal.
+//
+// Replaced subtrees are deleted, so the escaper must be run again before
+// generating code.
+class ConstantFolder : public ASTVisitor {
+  // Replacement for the last visited expression.
+  Expr *result;
+
+  // Declaration of the `print' primitive, created by the binder.
+  FunDecl &print_decl;
+
+  uses::UseCounter use_counter;
+  std::unordered_map<const VarDecl *, Expr *> constants;
+
+  Expr *fold(Expr *);
+
+public:
+  explicit ConstantFolder(FunDecl &print_decl) : print_decl(print_decl) {}
+  void fold_program(FunDecl &main);
+  virtual void visit(IntegerLiteral &);
+  virtual void visit(StringLiteral &);
+  virtual void visit(BinaryOperator &);
+  virtual void visit(Sequence &);
+  virtual void visit(Let &);
+  virtual void visit(Identifier &);
+  virtual void visit(IfThenElse &);
+  virtual void visit(VarDecl &);
+  virtual void visit(FunDecl &);
+  virtual void visit(FunCall &);
+  virtual void visit(WhileLoop &);
+  virtual void visit(ForLoop &);
+  virtual void visit(Break &);
+  virtual void visit(Assign &);
+};
+
+} // namespace constant_folder
+} // namespace ast
+
+#endif // CONSTANT_FOLDER_HH
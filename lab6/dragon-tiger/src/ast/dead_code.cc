@@ -0,0 +1,165 @@
+#include "dead_code.hh"
+
+namespace ast {
+namespace dead_code {
+
+namespace {
+
+class PurityChecker : public ConstASTVisitor {
+public:
+  bool pure = true;
+  virtual void visit(const IntegerLiteral &) {}
+  virtual void visit(const StringLiteral &) {}
+  virtual void visit(const BinaryOperator &op) {
+    // Division by zero is a runtime failure.
+    if (op.op == o_divide) {
+      auto divisor = dynamic_cast<const IntegerLiteral *>(&op.get_right());
+      if (!divisor || divisor->value == 0 || divisor->value == -1)
+        pure = false;
+    }
+    op.get_left().accept(*this);
+    op.get_right().accept(*this);
+  }
+  virtual void visit(const Sequence &seq) {
+    for (auto expr : seq.get_exprs())
+      expr->accept(*this);
+  }
+  virtual void visit(const Let &) { pure = false; }
+  virtual void visit(const Identifier &) {}
+  virtual void visit(const IfThenElse &ite) {
+    ite.get_condition().accept(*this);
+    ite.get_then_part().accept(*this);
+    ite.get_else_part().accept(*this);
+  }
+  virtual void visit(const VarDecl &) { pure = false; }
+  virtual void visit(const FunDecl &) { pure = false; }
+  virtual void visit(const FunCall &call) {
+    if (call.get_decl()->get_effects() & ~e_reads)
+      pure = false;
+    for (auto arg : call.get_args())
+      arg->accept(*this);
+  }
+  virtual void visit(const WhileLoop &) { pure = false; }
+  virtual void visit(const ForLoop &) { pure = false; }
+  virtual void visit(const Break &) { pure = false; }
+  virtual void visit(const Assign &) { pure = false; }
+};
+
+} // namespace
+
+bool is_pure(const Expr &expr) {
+  PurityChecker checker;
+  expr.accept(checker);
+  return checker.pure;
+}
+
+/* Runs the elimination until nothing more can be removed, since removing
+ * a declaration may leave other declarations or functions unused. */
+void DeadCodeEliminator::eliminate(FunDecl &main) {
+  do {
+    callgraph::CallGraph graph;
+    graph.analyze(main);
+    uses::UseCounter counter;
+    main.accept(counter);
+
+    call_graph = &graph;
+    use_counter = &counter;
+    changed = false;
+    main.accept(*this);
+  } while (changed);
+}
+
+void DeadCodeEliminator::visit(IntegerLiteral &literal) {}
+
+void DeadCodeEliminator::visit(StringLiteral &literal) {}
+
+void DeadCodeEliminator::visit(BinaryOperator &op) {
+  op.get_left().accept(*this);
+  op.get_right().accept(*this);
+}
+
+void DeadCodeEliminator::visit(Sequence &seq) {
+  std::vector<Expr *> &exprs = seq.get_exprs();
+  for (unsigned i = 0; i < exprs.size(); i++) {
+    exprs[i]->accept(*this);
+    if (!dynamic_cast<Break *>(exprs[i]) || i + 1 == exprs.size())
+      continue;
+    // The value of a non-void sequence is still needed to generate
+    // code, even if it is never computed.
+    unsigned end = seq.get_type() == t_void ? exprs.size() : exprs.size() - 1;
+    if (end <= i + 1)
+      break;
+    for (unsigned j = i + 1; j < end; j++)
+      delete exprs[j];
+    exprs.erase(exprs.begin() + i + 1, exprs.begin() + end);
+    changed = true;
+    break;
+  }
+}
+
+void DeadCodeEliminator::visit(Let &let) {
+  std::vector<Decl *> kept;
+  for (auto decl : let.get_decls()) {
+    if (FunDecl *fun = dynamic_cast<FunDecl *>(decl)) {
+      if (!call_graph->is_reachable(*fun)) {
+        delete fun;
+        changed = true;
+        continue;
+      }
+    } else {
+      VarDecl &var = dynamic_cast<VarDecl &>(*decl);
+      if (!use_counter->uses(var) && is_pure(var.get_expr().get())) {
+        delete decl;
+        changed = true;
+        continue;
+      }
+    }
+    decl->accept(*this);
+    kept.push_back(decl);
+  }
+  let.get_decls() = kept;
+  let.get_sequence().accept(*this);
+}
+
+void DeadCodeEliminator::visit(Identifier &id) {}
+
+void DeadCodeEliminator::visit(IfThenElse &ite) {
+  ite.get_condition().accept(*this);
+  ite.get_then_part().accept(*this);
+  ite.get_else_part().accept(*this);
+}
+
+void DeadCodeEliminator::visit(VarDecl &decl) {
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+}
+
+void DeadCodeEliminator::visit(FunDecl &decl) {
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+}
+
+void DeadCodeEliminator::visit(FunCall &call) {
+  for (auto arg : call.get_args())
+    arg->accept(*this);
+}
+
+void DeadCodeEliminator::visit(WhileLoop &loop) {
+  loop.get_condition().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void DeadCodeEliminator::visit(ForLoop &loop) {
+  loop.get_variable().accept(*this);
+  loop.get_high().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void DeadCodeEliminator::visit(Break &b) {}
+
+void DeadCodeEliminator::visit(Assign &assign) {
+  assign.get_rhs().accept(*this);
+}
+
+} // namespace dead_code
+} // namespace ast
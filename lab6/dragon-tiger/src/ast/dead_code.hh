@@ -0,0 +1,52 @@
+#ifndef DEAD_CODE_HH
+#define DEAD_CODE_HH
+
+#include "callgraph.hh"
+#include "nodes.hh"
+#include "uses.hh"
+
+namespace ast {
+namespace dead_code {
+
+// Dead code elimination on a typed AST, so that no code is generated for
+// it. Removes:
+//   - function declarations which cannot be reached from main;
+//   - variable declarations which are never used and whose initial value
+//     can be computed without any side effect;
+//   - expressions following a break in a sequence.
+//
+// The effect analysis must have been run beforehand. Removed subtrees are
+// deleted, so the escaper must be run again before generating code.
+class DeadCodeEliminator : public ASTVisitor {
+  callgraph::CallGraph *call_graph;
+  uses::UseCounter *use_counter;
+  bool changed;
+
+public:
+  DeadCodeEliminator() {}
+  void eliminate(FunDecl &main);
+  virtual void visit(IntegerLiteral &);
+  virtual void visit(StringLiteral &);
+  virtual void visit(BinaryOperator &);
+  virtual void visit(Sequence &);
+  virtual void visit(Let &);
+  virtual void visit(Identifier &);
+  virtual void visit(IfThenElse &);
+  virtual void visit(VarDecl &);
+  virtual void visit(FunDecl &);
+  virtual void visit(FunCall &);
+  virtual void visit(WhileLoop &);
+  virtual void visit(ForLoop &);
+  virtual void visit(Break &);
+  virtual void visit(Assign &);
+};
+
+// Whether an expression can be evaluated without any side effect, which
+// includes failing at runtime or not terminating. Function declarations
+// must have been annotated by the effect analysis.
+bool is_pure(const Expr &);
+
+} // namespace dead_code
+} // namespace ast
+
+#endif // DEAD_CODE_HH
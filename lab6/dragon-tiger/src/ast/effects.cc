@@ -0,0 +1,160 @@
+#include <algorithm>
+
+#include "callgraph.hh"
+#include "effects.hh"
+#include "primitives.hh"
+
+namespace ast {
+namespace effects {
+
+unsigned primitive_effects(const Symbol &external_name) {
+  const primitives::Primitive *primitive =
+      primitives::find_external(external_name);
+  return primitive ? primitive->effects : static_cast<unsigned>(e_all);
+}
+
+/* Collects the effects of each function body, then propagates them
+ * from callees to callers one strongly connected component at a time.
+ * Functions inside a component are iterated until a fixpoint is reached. */
+void EffectAnalyzer::analyze(FunDecl &main) {
+  main.accept(*this);
+
+  callgraph::CallGraph call_graph;
+  call_graph.analyze(main);
+
+  for (auto &component : call_graph.sccs()) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (auto decl : component)
+        changed |= update(const_cast<FunDecl &>(*decl),
+                          call_graph.callees(*decl),
+                          call_graph.is_recursive(*decl));
+    }
+  }
+}
+
+/* Recomputes the effects of a function from its body and its callees.
+ * Returns true if they changed. */
+bool EffectAnalyzer::update(FunDecl &decl,
+                            const std::vector<const FunDecl *> &callees,
+                            bool recursive) {
+  if (!decl.get_expr()) {
+    decl.set_effects(primitive_effects(decl.get_external_name()));
+    return false;
+  }
+
+  Info &info = infos[&decl];
+  Info before = info;
+
+  // Recursion is not proven to terminate.
+  if (recursive)
+    info.effects |= e_diverges;
+
+  for (auto callee : callees) {
+    if (!callee->get_expr()) {
+      info.effects |= primitive_effects(callee->get_external_name());
+      continue;
+    }
+    const Info &callee_info = infos[callee];
+    info.effects |= callee_info.effects & (e_io | e_diverges);
+    // The parameters and locals of the callee are not visible from the
+    // caller, only the variables of the functions enclosing the callee.
+    if (callee_info.read_depth < callee->get_depth())
+      info.read_depth = std::min(info.read_depth, callee_info.read_depth);
+    if (callee_info.write_depth < callee->get_depth())
+      info.write_depth = std::min(info.write_depth, callee_info.write_depth);
+  }
+
+  // Only variables of enclosing functions are visible from the caller.
+  unsigned effects = info.effects;
+  if (info.read_depth < decl.get_depth())
+    effects |= e_reads;
+  if (info.write_depth < decl.get_depth())
+    effects |= e_writes;
+  decl.set_effects(effects);
+
+  return info.effects != before.effects ||
+         info.read_depth != before.read_depth ||
+         info.write_depth != before.write_depth;
+}
+
+void EffectAnalyzer::visit(IntegerLiteral &literal) {}
+
+void EffectAnalyzer::visit(StringLiteral &literal) {}
+
+void EffectAnalyzer::visit(BinaryOperator &op) {
+  // Dividing by zero, or the minimal integer by -1, fails at runtime.
+  if (op.op == o_divide) {
+    auto divisor = dynamic_cast<IntegerLiteral *>(&op.get_right());
+    if (!divisor || divisor->value == 0 || divisor->value == -1)
+      infos[functions.back()].effects |= e_diverges;
+  }
+  op.get_left().accept(*this);
+  op.get_right().accept(*this);
+}
+
+void EffectAnalyzer::visit(Sequence &seq) {
+  for (auto expr : seq.get_exprs())
+    expr->accept(*this);
+}
+
+void EffectAnalyzer::visit(Let &let) {
+  for (auto decl : let.get_decls())
+    decl->accept(*this);
+  let.get_sequence().accept(*this);
+}
+
+void EffectAnalyzer::visit(Identifier &id) {
+  Info &info = infos[functions.back()];
+  info.read_depth = std::min(info.read_depth, id.get_decl()->get_depth());
+}
+
+void EffectAnalyzer::visit(IfThenElse &ite) {
+  ite.get_condition().accept(*this);
+  ite.get_then_part().accept(*this);
+  ite.get_else_part().accept(*this);
+}
+
+void EffectAnalyzer::visit(VarDecl &decl) {
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+}
+
+void EffectAnalyzer::visit(FunDecl &decl) {
+  functions.push_back(&decl);
+  infos[&decl];
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+  functions.pop_back();
+}
+
+void EffectAnalyzer::visit(FunCall &call) {
+  for (auto arg : call.get_args())
+    arg->accept(*this);
+}
+
+void EffectAnalyzer::visit(WhileLoop &loop) {
+  // While loops are not proven to terminate.
+  infos[functions.back()].effects |= e_diverges;
+  loop.get_condition().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void EffectAnalyzer::visit(ForLoop &loop) {
+  loop.get_variable().accept(*this);
+  loop.get_high().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void EffectAnalyzer::visit(Break &b) {}
+
+void EffectAnalyzer::visit(Assign &assign) {
+  Info &info = infos[functions.back()];
+  info.write_depth =
+      std::min(info.write_depth, assign.get_lhs().get_decl()->get_depth());
+  assign.get_rhs().accept(*this);
+}
+
+} // namespace effects
+} // namespace ast
@@ -0,0 +1,71 @@
+#ifndef EFFECTS_HH
+#define EFFECTS_HH
+
+#include <climits>
+#include <unordered_map>
+
+#include "nodes.hh"
+
+namespace ast {
+namespace effects {
+
+// Side-effect analysis. Every function declaration reachable from main
+// gets a set of effects describing what a call to it may do besides
+// computing its result:
+//
+//   - e_reads: read variables of an enclosing function frame;
+//   - e_writes: assign variables of an enclosing function frame;
+//   - e_io: perform input or output;
+//   - e_diverges: never return, either by exiting the program, by
+//     failing at runtime or by not terminating.
+//
+// A function with no effect is pure: calls to it with the same arguments
+// can be merged, hoisted or removed if unused. A function with only e_reads
+// can be merged or hoisted as long as no write happens in between.
+class EffectAnalyzer : public ASTVisitor {
+  struct Info {
+    // Shallowest depth of the variables read or written from this
+    // function body, INT_MAX if none.
+    int read_depth = INT_MAX;
+    int write_depth = INT_MAX;
+    unsigned effects = 0;
+  };
+
+  std::unordered_map<const FunDecl *, Info> infos;
+  std::vector<FunDecl *> functions;
+
+  bool update(FunDecl &, const std::vector<const FunDecl *> &callees,
+              bool recursive);
+
+public:
+  EffectAnalyzer() {}
+  void analyze(FunDecl &main);
+  virtual void visit(IntegerLiteral &);
+  virtual void visit(StringLiteral &);
+  virtual void visit(BinaryOperator &);
+  virtual void visit(Sequence &);
+  virtual void visit(Let &);
+  virtual void visit(Identifier &);
+  virtual void visit(IfThenElse &);
+  virtual void visit(VarDecl &);
+  virtual void visit(FunDecl &);
+  virtual void visit(FunCall &);
+  virtual void visit(WhileLoop &);
+  virtual void visit(ForLoop &);
+  virtual void visit(Break &);
+  virtual void visit(Assign &);
+};
+
+// Effects of the primitive with the given external name.
+unsigned primitive_effects(const Symbol &external_name);
+
+inline bool is_pure(const FunDecl &decl) { return decl.get_effects() == 0; }
+
+inline bool is_read_only(const FunDecl &decl) {
+  return (decl.get_effects() & ~e_reads) == 0;
+}
+
+} // namespace effects
+} // namespace ast
+
+#endif // EFFECTS_HH
@@ -5,8 +5,60 @@ namespace escaper {
 
 Escaper::Escaper() {}
 
+/* Computes escaping variables and static link requirements. Results from
+ * a previous run are discarded, so that the analysis can be run again after
+ * the AST has been transformed. */
 void Escaper::escape_decls(FunDecl *main) {
     main->accept(*this);
+    for (auto entry : decls) {
+        if (entry.second->get_escapes())
+            entry.first->get_escaping_decls().push_back(entry.second);
+    }
+    compute_static_links();
+}
+
+/* Propagates the static link reach of callees to their callers, and of
+ * nested functions to their parents, until a fixpoint is reached. Calling
+ * a function which climbs k levels from its own frame requires the caller
+ * to climb up to the same frame. A nested function climbing k levels goes
+ * through the static link stored in the frame of its parent, which must
+ * then climb k - 1 levels itself, even if the nested function is never
+ * called. Then a function needs its static link parameter only if it
+ * climbs at least one level, and it must store it in its frame only if
+ * one of its children climbs past it. */
+void Escaper::compute_static_links() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto call : calls) {
+            FunDecl *caller = call.first;
+            FunDecl *callee = call.second;
+            if (reach[callee] < 1)
+                continue;
+            int levels = caller->get_depth() - callee->get_depth() + reach[callee];
+            if (levels > reach[caller]) {
+                reach[caller] = levels;
+                changed = true;
+            }
+        }
+        for (auto entry : reach) {
+            if (entry.second < 2 || !entry.first->get_parent())
+                continue;
+            int &parent_reach = reach.at(&entry.first->get_parent().get());
+            if (entry.second - 1 > parent_reach) {
+                parent_reach = entry.second - 1;
+                changed = true;
+            }
+        }
+    }
+
+    for (auto entry : reach) {
+        FunDecl *decl = entry.first;
+        if (entry.second >= 1)
+            decl->set_needs_static_link();
+        if (entry.second >= 2 && decl->get_parent())
+            decl->get_parent()->set_stores_static_link();
+    }
 }
 
 void Escaper::visit(IntegerLiteral &literal) {
@@ -34,6 +86,15 @@ void Escaper::visit(Let &let) {
 }
 
 void Escaper::visit(Identifier &id) {
+    // Void variables hold no value, reading or assigning them never
+    // accesses a frame.
+    if (id.get_decl()->get_type() == t_void)
+        return;
+    int levels = id.get_depth() - id.get_decl()->get_depth();
+    if (levels > 0)
+        id.get_decl()->set_escapes();
+    if (levels > reach[current_function])
+        reach[current_function] = levels;
 }
 
 void Escaper::visit(IfThenElse &ite) {
@@ -43,23 +104,33 @@ void Escaper::visit(IfThenElse &ite) {
 }
 
 void Escaper::visit(VarDecl &decl) {
-    if (decl.get_escapes()) {
-        current_function->get_escaping_decls().push_back(&decl);
-    }
+    // Uses are always visited after the declaration.
+    decl.get_escapes() = false;
+    decls.push_back(std::make_pair(current_function, &decl));
     if (decl.get_expr()) {
         decl.get_expr()->accept(*this);
     }
 }
 
 void Escaper::visit(FunDecl &decl) {
+    functions.push_back(&decl);
     current_function =  &decl;
+    reach[&decl];
+    decl.get_escaping_decls().clear();
+    decl.get_needs_static_link() = false;
+    decl.get_stores_static_link() = false;
     for (auto param : decl.get_params()) {
         param->accept(*this);
     }
     decl.get_expr()->accept(*this);
+    functions.pop_back();
+    if (!functions.empty())
+        current_function = functions.back();
 }
 
 void Escaper::visit(FunCall &call) {
+    if (!call.get_decl()->is_external)
+        calls.push_back(std::make_pair(current_function, &call.get_decl().get()));
     for (auto arg : call.get_args()) {
         arg->accept(*this);
     }
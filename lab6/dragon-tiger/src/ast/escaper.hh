@@ -1,6 +1,9 @@
 #ifndef ESCAPER_HH
 #define ESCAPER_HH
 
+#include <unordered_map>
+#include <utility>
+
 #include "nodes.hh"
 
 namespace ast {
@@ -9,6 +12,20 @@ namespace escaper {
 class Escaper : public ASTVisitor {
 
   FunDecl *current_function;
+  std::vector<FunDecl *> functions;
+
+  // Number of static link levels each function must climb to reach
+  // the outermost frame it accesses, either directly or through the
+  // functions it calls.
+  std::unordered_map<FunDecl *, int> reach;
+
+  // Calls between non-external functions, as (caller, callee) pairs.
+  std::vector<std::pair<FunDecl *, FunDecl *>> calls;
+
+  // Variable declarations with their enclosing function, in order.
+  std::vector<std::pair<FunDecl *, VarDecl *>> decls;
+
+  void compute_static_links();
 
 public:
   Escaper();
@@ -33,4 +50,4 @@ public:
 } // namespace escaper
 } // namespace ast
 
-#endif // ESCAPER_HH
\ No newline at end of file
+#endif // ESCAPER_HH
@@ -0,0 +1,311 @@
+#include <unordered_map>
+
+#include "inliner.hh"
+
+namespace ast {
+namespace inliner {
+
+namespace {
+
+/* Counts the nodes of an expression and detects function declarations */
+class SizeCounter : public ConstASTVisitor {
+public:
+  unsigned size = 0;
+  bool has_functions = false;
+  virtual void visit(const IntegerLiteral &) { size++; }
+  virtual void visit(const StringLiteral &) { size++; }
+  virtual void visit(const BinaryOperator &op) {
+    size++;
+    op.get_left().accept(*this);
+    op.get_right().accept(*this);
+  }
+  virtual void visit(const Sequence &seq) {
+    for (auto expr : seq.get_exprs())
+      expr->accept(*this);
+  }
+  virtual void visit(const Let &let) {
+    size++;
+    for (auto decl : let.get_decls())
+      decl->accept(*this);
+    let.get_sequence().accept(*this);
+  }
+  virtual void visit(const Identifier &) { size++; }
+  virtual void visit(const IfThenElse &ite) {
+    size++;
+    ite.get_condition().accept(*this);
+    ite.get_then_part().accept(*this);
+    ite.get_else_part().accept(*this);
+  }
+  virtual void visit(const VarDecl &decl) {
+    size++;
+    if (auto expr = decl.get_expr())
+      expr->accept(*this);
+  }
+  virtual void visit(const FunDecl &) { has_functions = true; }
+  virtual void visit(const FunCall &call) {
+    size++;
+    for (auto arg : call.get_args())
+      arg->accept(*this);
+  }
+  virtual void visit(const WhileLoop &loop) {
+    size++;
+    loop.get_condition().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const ForLoop &loop) {
+    size++;
+    loop.get_variable().accept(*this);
+    loop.get_high().accept(*this);
+    loop.get_body().accept(*this);
+  }
+  virtual void visit(const Break &) { size++; }
+  virtual void visit(const Assign &assign) {
+    size++;
+    assign.get_rhs().accept(*this);
+  }
+};
+
+/* Copies a function body into another function at a given depth. Local
+ * variables and loops are replaced by their copies, references to outer
+ * declarations are kept. */
+class Cloner : public ConstASTVisitor {
+  const int depth;
+  std::unordered_map<const VarDecl *, VarDecl *> &decls;
+  std::unordered_map<const Loop *, Loop *> loops;
+  Expr *result;
+
+  template <typename T> T *typed(T *node, const Node &original) {
+    if (original.get_type() != t_undef)
+      node->set_type(original.get_type());
+    return node;
+  }
+
+public:
+  Cloner(int _depth, std::unordered_map<const VarDecl *, VarDecl *> &_decls)
+      : depth(_depth), decls(_decls) {}
+
+  Expr *clone(const Expr &expr) {
+    expr.accept(*this);
+    return result;
+  }
+
+  VarDecl *clone_decl(const VarDecl &decl) {
+    Expr *expr = decl.get_expr() ? clone(decl.get_expr().get()) : nullptr;
+    VarDecl *copy = typed(new VarDecl(decl.loc, decl.name, expr,
+                                      decl.type_name, decl.read_only),
+                          decl);
+    copy->set_depth(depth);
+    decls[&decl] = copy;
+    return copy;
+  }
+
+  Identifier *clone_identifier(const Identifier &id) {
+    Identifier *copy = typed(new Identifier(id.loc, id.name), id);
+    const VarDecl *decl = &id.get_decl().get();
+    auto local = decls.find(decl);
+    copy->set_decl(local != decls.end() ? local->second
+                                        : const_cast<VarDecl *>(decl));
+    copy->set_depth(depth);
+    return copy;
+  }
+
+  virtual void visit(const IntegerLiteral &literal) {
+    result = typed(new IntegerLiteral(literal.loc, literal.value), literal);
+  }
+  virtual void visit(const StringLiteral &literal) {
+    result = typed(new StringLiteral(literal.loc, literal.value), literal);
+  }
+  virtual void visit(const BinaryOperator &op) {
+    Expr *left = clone(op.get_left());
+    Expr *right = clone(op.get_right());
+    result = typed(new BinaryOperator(op.loc, left, right, op.op), op);
+  }
+  virtual void visit(const Sequence &seq) {
+    std::vector<Expr *> exprs;
+    for (auto expr : seq.get_exprs())
+      exprs.push_back(clone(*expr));
+    result = typed(new Sequence(seq.loc, exprs), seq);
+  }
+  virtual void visit(const Let &let) {
+    std::vector<Decl *> let_decls;
+    for (auto decl : let.get_decls())
+      let_decls.push_back(clone_decl(dynamic_cast<const VarDecl &>(*decl)));
+    Sequence *seq =
+        static_cast<Sequence *>(clone(let.get_sequence()));
+    result = typed(new Let(let.loc, let_decls, seq), let);
+  }
+  virtual void visit(const Identifier &id) { result = clone_identifier(id); }
+  virtual void visit(const IfThenElse &ite) {
+    Expr *condition = clone(ite.get_condition());
+    Expr *then_part = clone(ite.get_then_part());
+    Expr *else_part = clone(ite.get_else_part());
+    result = typed(new IfThenElse(ite.loc, condition, then_part, else_part), ite);
+  }
+  virtual void visit(const VarDecl &) { assert(false); }
+  virtual void visit(const FunDecl &) { assert(false); }
+  virtual void visit(const FunCall &call) {
+    std::vector<Expr *> args;
+    for (auto arg : call.get_args())
+      args.push_back(clone(*arg));
+    FunCall *copy = typed(new FunCall(call.loc, args, call.func_name), call);
+    copy->set_decl(const_cast<FunDecl *>(&call.get_decl().get()));
+    copy->set_depth(depth);
+    result = copy;
+  }
+  virtual void visit(const WhileLoop &loop) {
+    // Breaks in the body refer to the copy, which must exist first.
+    WhileLoop *copy = typed(new WhileLoop(loop.loc, nullptr, nullptr), loop);
+    loops[&loop] = copy;
+    copy->set_condition(clone(loop.get_condition()));
+    copy->set_body(clone(loop.get_body()));
+    result = copy;
+  }
+  virtual void visit(const ForLoop &loop) {
+    VarDecl *variable = clone_decl(loop.get_variable());
+    ForLoop *copy = typed(new ForLoop(loop.loc, variable, nullptr, nullptr), loop);
+    loops[&loop] = copy;
+    copy->set_high(clone(loop.get_high()));
+    copy->set_body(clone(loop.get_body()));
+    result = copy;
+  }
+  virtual void visit(const Break &b) {
+    Break *copy = typed(new Break(b.loc), b);
+    copy->set_loop(loops.at(&b.get_loop().get()));
+    result = copy;
+  }
+  virtual void visit(const Assign &assign) {
+    Identifier *lhs = clone_identifier(assign.get_lhs());
+    Expr *rhs = clone(assign.get_rhs());
+    result = typed(new Assign(assign.loc, lhs, rhs), assign);
+  }
+};
+
+} // namespace
+
+void Inliner::inline_calls(FunDecl &main) {
+  call_graph.analyze(main);
+  main.accept(*this);
+}
+
+/* Processes an expression and returns its replacement. The original
+ * expression is deleted if it has been replaced. */
+Expr *Inliner::process(Expr *expr) {
+  result = expr;
+  expr->accept(*this);
+  Expr *processed = result;
+  if (processed != expr)
+    delete expr;
+  return processed;
+}
+
+bool Inliner::is_inlinable(const FunDecl &decl) {
+  if (!decl.get_expr() || decl.is_external || call_graph.is_recursive(decl))
+    return false;
+  SizeCounter counter;
+  decl.get_expr()->accept(counter);
+  return !counter.has_functions && counter.size <= threshold;
+}
+
+void Inliner::visit(IntegerLiteral &literal) { result = &literal; }
+
+void Inliner::visit(StringLiteral &literal) { result = &literal; }
+
+void Inliner::visit(BinaryOperator &op) {
+  op.set_left(process(&op.get_left()));
+  op.set_right(process(&op.get_right()));
+  result = &op;
+}
+
+void Inliner::visit(Sequence &seq) {
+  for (auto &expr : seq.get_exprs())
+    expr = process(expr);
+  result = &seq;
+}
+
+void Inliner::visit(Let &let) {
+  for (auto decl : let.get_decls())
+    decl->accept(*this);
+  let.get_sequence().accept(*this);
+  result = &let;
+}
+
+void Inliner::visit(Identifier &id) { result = &id; }
+
+void Inliner::visit(IfThenElse &ite) {
+  ite.set_condition(process(&ite.get_condition()));
+  ite.set_then_part(process(&ite.get_then_part()));
+  ite.set_else_part(process(&ite.get_else_part()));
+  result = &ite;
+}
+
+void Inliner::visit(VarDecl &decl) {
+  if (auto expr = decl.get_expr())
+    decl.set_expr(process(&expr.get()));
+}
+
+void Inliner::visit(FunDecl &decl) {
+  functions.push_back(&decl);
+  if (auto expr = decl.get_expr())
+    decl.set_expr(process(&expr.get()));
+  functions.pop_back();
+}
+
+void Inliner::visit(FunCall &call) {
+  for (auto &arg : call.get_args())
+    arg = process(arg);
+  result = &call;
+
+  const FunDecl &callee = call.get_decl().get();
+  if (depth >= max_depth || !is_inlinable(callee))
+    return;
+
+  // Arguments are evaluated in order into fresh copies of the parameters.
+  std::unordered_map<const VarDecl *, VarDecl *> decls;
+  Cloner cloner(functions.back()->get_depth(), decls);
+  std::vector<Decl *> params;
+  for (unsigned i = 0; i < call.get_args().size(); i++) {
+    const VarDecl &param = *callee.get_params()[i];
+    VarDecl *copy = new VarDecl(param.loc, param.name, call.get_args()[i],
+                                param.type_name);
+    copy->set_type(param.get_type());
+    copy->set_depth(functions.back()->get_depth());
+    decls[&param] = copy;
+    params.push_back(copy);
+  }
+  call.get_args().clear();
+
+  Expr *body = cloner.clone(callee.get_expr().get());
+  Sequence *seq = new Sequence(call.loc, std::vector<Expr *>({body}));
+  seq->set_type(body->get_type());
+  Let *let = new Let(call.loc, params, seq);
+  let->set_type(body->get_type());
+
+  // Calls in the inlined body may be inlined in turn.
+  depth++;
+  let->get_sequence().accept(*this);
+  depth--;
+  result = let;
+}
+
+void Inliner::visit(WhileLoop &loop) {
+  loop.set_condition(process(&loop.get_condition()));
+  loop.set_body(process(&loop.get_body()));
+  result = &loop;
+}
+
+void Inliner::visit(ForLoop &loop) {
+  loop.get_variable().accept(*this);
+  loop.set_high(process(&loop.get_high()));
+  loop.set_body(process(&loop.get_body()));
+  result = &loop;
+}
+
+void Inliner::visit(Break &b) { result = &b; }
+
+void Inliner::visit(Assign &assign) {
+  assign.set_rhs(process(&assign.get_rhs()));
+  result = &assign;
+}
+
+} // namespace inliner
+} // namespace ast
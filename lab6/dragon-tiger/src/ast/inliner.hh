@@ -0,0 +1,56 @@
+#ifndef INLINER_HH
+#define INLINER_HH
+
+#include "callgraph.hh"
+#include "nodes.hh"
+
+namespace ast {
+namespace inliner {
+
+// Inlines calls to small non-recursive functions on a typed AST. A call
+// `f(a, b)' to `function f(x: int, y: int) = body' is replaced by
+// `let var x := a var y := b in body' where the body is a copy of the
+// function body bound to the new declarations. Functions declaring nested
+// functions are never inlined.
+//
+// Inlined bodies are processed in turn, up to max_depth nested inlinings.
+// The escaper must be run again before generating code.
+class Inliner : public ASTVisitor {
+  // Maximum number of nodes in the body of an inlined function.
+  const unsigned threshold;
+  const unsigned max_depth;
+
+  callgraph::CallGraph call_graph;
+  std::vector<FunDecl *> functions;
+  unsigned depth = 0;
+
+  // Replacement for the last visited expression.
+  Expr *result;
+
+  Expr *process(Expr *);
+  bool is_inlinable(const FunDecl &);
+
+public:
+  Inliner(unsigned _threshold = 20, unsigned _max_depth = 3)
+      : threshold(_threshold), max_depth(_max_depth) {}
+  void inline_calls(FunDecl &main);
+  virtual void visit(IntegerLiteral &);
+  virtual void visit(StringLiteral &);
+  virtual void visit(BinaryOperator &);
+  virtual void visit(Sequence &);
+  virtual void visit(Let &);
+  virtual void visit(Identifier &);
+  virtual void visit(IfThenElse &);
+  virtual void visit(VarDecl &);
+  virtual void visit(FunDecl &);
+  virtual void visit(FunCall &);
+  virtual void visit(WhileLoop &);
+  virtual void visit(ForLoop &);
+  virtual void visit(Break &);
+  virtual void visit(Assign &);
+};
+
+} // namespace inliner
+} // namespace ast
+
+#endif // INLINER_HH
@@ -38,10 +38,19 @@ typedef enum {
   o_lt,
   o_le,
   o_gt,
-  o_ge
+  o_ge,
+  o_and,
+  o_or
 } Operator;
-const std::string operator_name[] = {"+",  "-", "*",  "/", "=",
-                                     "<>", "<", "<=", ">", ">="};
+const std::string operator_name[] = {"+",  "-", "*",  "/", "=", "<>",
+                                     "<",  "<=", ">", ">=", "&", "|"};
+typedef enum {
+  e_reads = 1,
+  e_writes = 2,
+  e_io = 4,
+  e_diverges = 8,
+  e_all = e_reads | e_writes | e_io | e_diverges
+} Effect;
 
 class ASTVisitor {
 public:
@@ -238,11 +247,13 @@ public:
     delete left;
   }
 
-  // Getters for field `left'
+  // Setter and getters for field `left'
+  void set_left(Expr *_left) { left = _left; }
   Expr &get_left() { return *left; }
   const Expr &get_left() const { return *left; }
 
-  // Getters for field `right'
+  // Setter and getters for field `right'
+  void set_right(Expr *_right) { right = _right; }
   Expr &get_right() { return *right; }
   const Expr &get_right() const { return *right; }
 
@@ -396,15 +407,18 @@ public:
     delete condition;
   }
 
-  // Getters for field `condition'
+  // Setter and getters for field `condition'
+  void set_condition(Expr *_condition) { condition = _condition; }
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
 
-  // Getters for field `then_part'
+  // Setter and getters for field `then_part'
+  void set_then_part(Expr *_then_part) { then_part = _then_part; }
   Expr &get_then_part() { return *then_part; }
   const Expr &get_then_part() const { return *then_part; }
 
-  // Getters for field `else_part'
+  // Setter and getters for field `else_part'
+  void set_else_part(Expr *_else_part) { else_part = _else_part; }
   Expr &get_else_part() { return *else_part; }
   const Expr &get_else_part() const { return *else_part; }
 
@@ -439,7 +453,8 @@ public:
   // Destructor
   virtual ~VarDecl() { delete expr; }
 
-  // Getters for field `expr'
+  // Setter and getters for field `expr'
+  void set_expr(Expr *_expr) { expr = _expr; }
   optional<Expr &> get_expr() {
     if (!expr)
       return boost::none;
@@ -475,6 +490,9 @@ class FunDecl : public Decl {
   Symbol external_name = Symbol();
   FunDecl *parent = nullptr;
   std::vector<VarDecl *> escaping_decls = std::vector<VarDecl *>();
+  bool needs_static_link = false;
+  bool stores_static_link = false;
+  unsigned effects = e_all;
 
 public:
   // Public fields
@@ -499,7 +517,8 @@ public:
   std::vector<VarDecl *> &get_params() { return params; }
   const std::vector<VarDecl *> &get_params() const { return params; }
 
-  // Getters for field `expr'
+  // Setter and getters for field `expr'
+  void set_expr(Expr *_expr) { expr = _expr; }
   optional<Expr &> get_expr() {
     if (!expr)
       return boost::none;
@@ -541,6 +560,25 @@ public:
     return escaping_decls;
   }
 
+  // Setter and getters for field `needs_static_link'
+  void set_needs_static_link() { needs_static_link = true; }
+  bool &get_needs_static_link() { return needs_static_link; }
+  const bool &get_needs_static_link() const { return needs_static_link; }
+
+  // Setter and getters for field `stores_static_link'. A function can
+  // only store a static link it receives.
+  void set_stores_static_link() {
+    stores_static_link = true;
+    needs_static_link = true;
+  }
+  bool &get_stores_static_link() { return stores_static_link; }
+  const bool &get_stores_static_link() const { return stores_static_link; }
+
+  // Setter and getters for field `effects'
+  void set_effects(unsigned _effects) { effects = _effects; }
+  unsigned &get_effects() { return effects; }
+  const unsigned &get_effects() const { return effects; }
+
   // Acceptor method for visitors
   virtual void accept(ASTVisitor &visitor) { visitor.visit(*this); }
   virtual void accept(ConstASTVisitor &visitor) const { visitor.visit(*this); }
@@ -636,11 +674,13 @@ public:
     delete condition;
   }
 
-  // Getters for field `condition'
+  // Setter and getters for field `condition'
+  void set_condition(Expr *_condition) { condition = _condition; }
   Expr &get_condition() { return *condition; }
   const Expr &get_condition() const { return *condition; }
 
-  // Getters for field `body'
+  // Setter and getters for field `body'
+  void set_body(Expr *_body) { body = _body; }
   Expr &get_body() { return *body; }
   const Expr &get_body() const { return *body; }
 
@@ -678,11 +718,13 @@ public:
   VarDecl &get_variable() { return *variable; }
   const VarDecl &get_variable() const { return *variable; }
 
-  // Getters for field `high'
+  // Setter and getters for field `high'
+  void set_high(Expr *_high) { high = _high; }
   Expr &get_high() { return *high; }
   const Expr &get_high() const { return *high; }
 
-  // Getters for field `body'
+  // Setter and getters for field `body'
+  void set_body(Expr *_body) { body = _body; }
   Expr &get_body() { return *body; }
   const Expr &get_body() const { return *body; }
 
@@ -754,7 +796,8 @@ public:
   Identifier &get_lhs() { return *lhs; }
   const Identifier &get_lhs() const { return *lhs; }
 
-  // Getters for field `rhs'
+  // Setter and getters for field `rhs'
+  void set_rhs(Expr *_rhs) { rhs = _rhs; }
   Expr &get_rhs() { return *rhs; }
   const Expr &get_rhs() const { return *rhs; }
 
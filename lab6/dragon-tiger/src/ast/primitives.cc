@@ -0,0 +1,74 @@
+#include <sstream>
+#include <unordered_map>
+
+#include "primitives.hh"
+#include "../utils/nolocation.hh"
+
+namespace ast {
+namespace primitives {
+
+const std::vector<Primitive> &all() {
+  static const std::vector<Primitive> primitives = {
+      {"print_err", nullptr, {"string"}, e_io, m_any, false, false},
+      {"print", nullptr, {"string"}, e_io, m_any, false, false},
+      {"print_int", nullptr, {"int"}, e_io, m_any, false, false},
+      {"flush", nullptr, {}, e_io, m_any, false, false},
+      {"getchar", "string", {}, e_io, m_any, true, false},
+      // ord and chr set the locale and convert characters with the
+      // hidden state of the C library, chr fails when out of range.
+      {"ord", "int", {"string"}, 0, m_any, false, false},
+      {"chr", "string", {"int"}, e_diverges, m_any, true, false},
+      {"size", "int", {"string"}, 0, m_read_args, false, false},
+      // substring fails when out of bounds.
+      {"substring", "string", {"string", "int", "int"}, e_diverges, m_any,
+       true, false},
+      {"concat", "string", {"string", "string"}, 0, m_any, true, false},
+      {"strcmp", "int", {"string", "string"}, 0, m_read_args, false, false},
+      {"streq", "int", {"string", "string"}, 0, m_read_args, false, false},
+      {"not", "int", {"int"}, 0, m_none, false, false},
+      {"exit", nullptr, {"int"}, e_io | e_diverges, m_any, false, true},
+  };
+  return primitives;
+}
+
+const Primitive *find(const Symbol &name) {
+  static std::unordered_map<Symbol, const Primitive *> table;
+  if (table.empty())
+    for (auto &primitive : all())
+      table[Symbol(primitive.name)] = &primitive;
+  auto entry = table.find(name);
+  return entry == table.end() ? nullptr : entry->second;
+}
+
+const Primitive *find_external(const Symbol &external_name) {
+  const std::string &name = external_name.get();
+  if (name.compare(0, 2, "__") != 0)
+    return nullptr;
+  return find(Symbol(name.substr(2)));
+}
+
+Symbol external_name(const Primitive &primitive) {
+  return Symbol(std::string("__") + primitive.name);
+}
+
+FunDecl *make_declaration(const Primitive &primitive) {
+  std::vector<VarDecl *> args;
+  int counter = 0;
+  for (const char *type_name : primitive.param_types) {
+    std::ostringstream argname;
+    argname << "a_" << counter++;
+    args.push_back(new VarDecl(utils::nl, Symbol(argname.str()), nullptr,
+                               Symbol(type_name)));
+  }
+
+  boost::optional<Symbol> type_name = boost::none;
+  if (primitive.type_name)
+    type_name = Symbol(primitive.type_name);
+  FunDecl *fd = new FunDecl(utils::nl, Symbol(primitive.name), std::move(args),
+                            nullptr, type_name, true);
+  fd->set_external_name(external_name(primitive));
+  return fd;
+}
+
+} // namespace primitives
+} // namespace ast
@@ -0,0 +1,52 @@
+#ifndef PRIMITIVES_HH
+#define PRIMITIVES_HH
+
+#include <vector>
+
+#include "nodes.hh"
+
+namespace ast {
+namespace primitives {
+
+// How a primitive accesses memory, as seen from the generated code.
+typedef enum {
+  m_none,      // no memory access at all
+  m_read_args, // only reads the strings given as arguments
+  m_read,      // also reads the runtime global state
+  m_any        // may write memory or perform input/output
+} Memory;
+
+// Description of a primitive implemented by the runtime. Type names are
+// Tiger type names, nullptr standing for void. This registry is the only
+// place where primitives are listed on the compiler side: the binder
+// declares them, the effect analysis and the IR generator take their
+// properties from it. It must be kept in sync with the runtime header.
+struct Primitive {
+  const char *name;
+  const char *type_name;
+  std::vector<const char *> param_types;
+  // Effects as computed by the effect analysis for Tiger functions.
+  unsigned effects;
+  Memory memory;
+  // The result is a newly allocated string.
+  bool allocates;
+  bool noreturn;
+};
+
+// All primitives, in declaration order.
+const std::vector<Primitive> &all();
+
+// Primitive with the given Tiger name or external name, or nullptr.
+const Primitive *find(const Symbol &name);
+const Primitive *find_external(const Symbol &external_name);
+
+// Name of the runtime function implementing a primitive.
+Symbol external_name(const Primitive &);
+
+// Builds a new untyped declaration for a primitive.
+FunDecl *make_declaration(const Primitive &);
+
+} // namespace primitives
+} // namespace ast
+
+#endif // PRIMITIVES_HH
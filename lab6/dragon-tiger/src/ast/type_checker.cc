@@ -37,6 +37,12 @@ void TypeChecker::visit(BinaryOperator &op) {
     ) {
         utils::error(op.loc, "cannot compare order of void expression");
     }
+    else if (
+        ((op.op == o_and) || (op.op == o_or))
+        && (op.get_left().get_type() != t_int)
+    ) {
+        utils::error(op.loc, "logical operands must be of type 'int'");
+    }
     else {
         op.set_type(t_int);
     }
@@ -0,0 +1,80 @@
+#include "uses.hh"
+
+namespace ast {
+namespace uses {
+
+unsigned UseCounter::reads(const VarDecl &decl) const {
+  auto count = read_counts.find(&decl);
+  return count == read_counts.end() ? 0 : count->second;
+}
+
+unsigned UseCounter::writes(const VarDecl &decl) const {
+  auto count = write_counts.find(&decl);
+  return count == write_counts.end() ? 0 : count->second;
+}
+
+void UseCounter::visit(const IntegerLiteral &literal) {}
+
+void UseCounter::visit(const StringLiteral &literal) {}
+
+void UseCounter::visit(const BinaryOperator &op) {
+  op.get_left().accept(*this);
+  op.get_right().accept(*this);
+}
+
+void UseCounter::visit(const Sequence &seq) {
+  for (auto expr : seq.get_exprs())
+    expr->accept(*this);
+}
+
+void UseCounter::visit(const Let &let) {
+  for (auto decl : let.get_decls())
+    decl->accept(*this);
+  let.get_sequence().accept(*this);
+}
+
+void UseCounter::visit(const Identifier &id) {
+  read_counts[&id.get_decl().get()]++;
+}
+
+void UseCounter::visit(const IfThenElse &ite) {
+  ite.get_condition().accept(*this);
+  ite.get_then_part().accept(*this);
+  ite.get_else_part().accept(*this);
+}
+
+void UseCounter::visit(const VarDecl &decl) {
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+}
+
+void UseCounter::visit(const FunDecl &decl) {
+  if (auto expr = decl.get_expr())
+    expr->accept(*this);
+}
+
+void UseCounter::visit(const FunCall &call) {
+  for (auto arg : call.get_args())
+    arg->accept(*this);
+}
+
+void UseCounter::visit(const WhileLoop &loop) {
+  loop.get_condition().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void UseCounter::visit(const ForLoop &loop) {
+  loop.get_variable().accept(*this);
+  loop.get_high().accept(*this);
+  loop.get_body().accept(*this);
+}
+
+void UseCounter::visit(const Break &b) {}
+
+void UseCounter::visit(const Assign &assign) {
+  write_counts[&assign.get_lhs().get_decl().get()]++;
+  assign.get_rhs().accept(*this);
+}
+
+} // namespace uses
+} // namespace ast
@@ -0,0 +1,43 @@
+#ifndef USES_HH
+#define USES_HH
+
+#include <unordered_map>
+
+#include "nodes.hh"
+
+namespace ast {
+namespace uses {
+
+// Counts, for every variable declaration, how many times it is read and
+// how many times it is assigned in a bound AST.
+class UseCounter : public ConstASTVisitor {
+  std::unordered_map<const VarDecl *, unsigned> read_counts;
+  std::unordered_map<const VarDecl *, unsigned> write_counts;
+
+public:
+  UseCounter() {}
+  unsigned reads(const VarDecl &decl) const;
+  unsigned writes(const VarDecl &decl) const;
+  unsigned uses(const VarDecl &decl) const {
+    return reads(decl) + writes(decl);
+  }
+  virtual void visit(const IntegerLiteral &);
+  virtual void visit(const StringLiteral &);
+  virtual void visit(const BinaryOperator &);
+  virtual void visit(const Sequence &);
+  virtual void visit(const Let &);
+  virtual void visit(const Identifier &);
+  virtual void visit(const IfThenElse &);
+  virtual void visit(const VarDecl &);
+  virtual void visit(const FunDecl &);
+  virtual void visit(const FunCall &);
+  virtual void visit(const WhileLoop &);
+  virtual void visit(const ForLoop &);
+  virtual void visit(const Break &);
+  virtual void visit(const Assign &);
+};
+
+} // namespace uses
+} // namespace ast
+
+#endif // USES_HH
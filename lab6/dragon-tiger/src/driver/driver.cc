@@ -3,7 +3,12 @@
 
 #include "../ast/ast_dumper.hh"
 #include "../ast/binder.hh"
+#include "../ast/callgraph.hh"
+#include "../ast/constant_folder.hh"
+#include "../ast/dead_code.hh"
+#include "../ast/effects.hh"
 #include "../ast/escaper.hh"
+#include "../ast/inliner.hh"
 #include "../ast/type_checker.hh"
 #include "../parser/parser_driver.hh"
 #include "../irgen/irgen.hh"
@@ -11,6 +16,8 @@
 
 int main(int argc, char **argv) {
   std::string output_file;
+  std::string opt_level;
+  irgen::BackendOptions backend_options;
   std::vector<std::string> input_files;
   namespace po = boost::program_options;
   po::options_description options("Options");
@@ -18,9 +25,43 @@ int main(int argc, char **argv) {
   ("help,h", "describe arguments")
   ("dump-ast", "dump the parsed AST")
   ("dump-ir", "dump the generated IR")
+  ("emit-bc", "write the generated IR as bitcode")
+  ("emit-obj", "optimize the generated IR and write it as object code")
+  ("runtime", po::value<std::string>(),
+   "link the used functions of a runtime bitcode file into the program")
+  ("optimize,O", po::value(&opt_level)->default_value("3"),
+   "optimization level of --emit-obj (0, 1, 2, 3 or s)")
+  ("passes", po::value(&backend_options.passes),
+   "pass pipeline replacing the one of the optimization level, "
+   "in the syntax of opt -passes")
+  ("verify", "verify the generated IR and the optimized code")
+  ("march", po::value<std::string>(),
+   "target CPU, or native for the host CPU and all its features")
+  ("mcpu", po::value(&backend_options.cpu),
+   "target CPU, overriding -march")
+  ("mattr", po::value<std::string>(),
+   "target features to enable (+feature) or disable (-feature), "
+   "separated by commas")
+  ("jobs,j", po::value(&backend_options.jobs)->default_value(1),
+   "number of partitions optimized and compiled in parallel by --emit-obj, "
+   "partition i being written to the output file suffixed with .i")
+  ("profile-generate",
+   po::value(&backend_options.profile_generate)
+       ->implicit_value("default.profraw"),
+   "instrument the program to write a raw profile into the given file")
+  ("profile-use", po::value(&backend_options.profile_use),
+   "optimize the program using the given indexed profile")
+  ("output,o", po::value(&output_file)->default_value("-"),
+   "output file for the generated IR (- for standard output)")
+  ("dump-callgraph", po::value<std::string>(),
+   "dump the call graph in the given format (dot or json)")
   ("bind,b", "run the binder on the parsed AST")
   ("type,t", "run the type checker on the parsed AST")
   ("irgen,i", "run the LLVM IR code generator")
+  ("debug,g", "generate debug information")
+  ("no-fold", "disable constant folding and propagation")
+  ("no-dce", "disable dead code elimination")
+  ("no-inline", "disable function inlining")
   ("trace-parser", "enable parser traces")
   ("trace-lexer", "enable lexer traces")
   ("verbose,v", "be verbose")
@@ -30,9 +71,15 @@ int main(int argc, char **argv) {
   positional.add("input-file", 1);
 
   po::variables_map vm;
+  // Target options are written with a single dash, as in -march=native.
+  // Long options are not guessed from their prefix, so that short
+  // options such as -t keep their meaning.
   po::store(po::command_line_parser(argc, argv)
                 .options(options)
                 .positional(positional)
+                .style((po::command_line_style::unix_style ^
+                        po::command_line_style::allow_guessing) |
+                       po::command_line_style::allow_long_disguise)
                 .run(),
             vm);
   po::notify(vm);
@@ -46,6 +93,40 @@ int main(int argc, char **argv) {
     utils::error("usage: dtiger [options] input-file");
   }
 
+  if (vm.count("dump-ir") + vm.count("emit-bc") + vm.count("emit-obj") > 1) {
+    utils::error("only one of --dump-ir, --emit-bc and --emit-obj can be used");
+  }
+
+  if (vm.count("profile-generate") && vm.count("profile-use")) {
+    utils::error("--profile-generate and --profile-use cannot be used together");
+  }
+
+  if (opt_level == "s") {
+    backend_options.opt_level = 2;
+    backend_options.size_level = 1;
+  } else if (opt_level.size() == 1 && opt_level[0] >= '0' && opt_level[0] <= '3') {
+    backend_options.opt_level = opt_level[0] - '0';
+  } else {
+    utils::error("unknown optimization level " + opt_level);
+  }
+  backend_options.verify = vm.count("verify");
+
+  if (vm.count("march")) {
+    const std::string march = vm["march"].as<std::string>();
+    const std::string cpu = backend_options.cpu;
+    if (march == "native")
+      backend_options.target_host();
+    else
+      backend_options.cpu = march;
+    if (vm.count("mcpu"))
+      backend_options.cpu = cpu;
+  }
+  if (vm.count("mattr")) {
+    const std::string mattr = vm["mattr"].as<std::string>();
+    backend_options.features +=
+        (backend_options.features.empty() ? "" : ",") + mattr;
+  }
+
   ParserDriver parser_driver = ParserDriver(vm.count("trace-lexer"), vm.count("trace-parser"));
 
   if (!parser_driver.parse(input_files[0])) {
@@ -53,11 +134,14 @@ int main(int argc, char **argv) {
   }
 
   FunDecl *main = nullptr;
-  if (vm.count("bind") || vm.count("type") || vm.count("irgen")) {
+  FunDecl *print_decl = nullptr;
+  if (vm.count("bind") || vm.count("type") || vm.count("irgen") ||
+      vm.count("dump-callgraph")) {
     ast::binder::Binder binder;
     main = binder.analyze_program(*parser_driver.result_ast);
-    ast::escaper::Escaper escaper;
-    main->accept(escaper);
+    print_decl = &binder.primitive(Symbol("print"));
+    ast::effects::EffectAnalyzer effect_analyzer;
+    effect_analyzer.analyze(*main);
   }
 
   if (vm.count("type") || vm.count("irgen")) {
@@ -65,12 +149,68 @@ int main(int argc, char **argv) {
     main->accept(type_checker);
   }
 
+  if (vm.count("dump-callgraph")) {
+    const std::string format = vm["dump-callgraph"].as<std::string>();
+    ast::callgraph::CallGraph call_graph;
+    call_graph.analyze(*main);
+    if (format == "dot")
+      call_graph.dump_dot(&std::cout);
+    else if (format == "json")
+      call_graph.dump_json(&std::cout);
+    else
+      utils::error("unknown call graph format " + format);
+  }
+
+  if (vm.count("irgen") && !vm.count("no-fold")) {
+    ast::constant_folder::ConstantFolder folder(*print_decl);
+    folder.fold_program(*main);
+  }
+
+  if (vm.count("irgen") && !vm.count("no-inline")) {
+    ast::inliner::Inliner inliner;
+    inliner.inline_calls(*main);
+    // Inlined arguments are often constants.
+    if (!vm.count("no-fold")) {
+      ast::constant_folder::ConstantFolder folder(*print_decl);
+      folder.fold_program(*main);
+    }
+  }
+
+  if (vm.count("irgen") && !vm.count("no-dce")) {
+    ast::dead_code::DeadCodeEliminator eliminator;
+    eliminator.eliminate(*main);
+  }
+
   if (vm.count("irgen")) {
+    // Escaping variables and static links are computed on the final AST.
+    ast::escaper::Escaper escaper;
+    escaper.escape_decls(main);
+
     irgen::IRGenerator ir_generator;
+    if (vm.count("debug")) {
+      ir_generator.enable_debug_info(input_files[0]);
+    }
+    if (vm.count("verify")) {
+      ir_generator.enable_verification();
+    }
     ir_generator.generate_program(main);
+    if (vm.count("runtime")) {
+      ir_generator.link_runtime(vm["runtime"].as<std::string>());
+    }
+    if (vm.count("march") || vm.count("mcpu") || vm.count("mattr")) {
+      ir_generator.set_target_attributes(backend_options);
+    }
 
+    // The output is written directly to the output file descriptor.
+    std::cout.flush();
     if (vm.count("dump-ir")) {
-      ir_generator.print_ir(&std::cout);
+      ir_generator.print_ir(output_file);
+    }
+    if (vm.count("emit-bc")) {
+      ir_generator.emit_bitcode(output_file);
+    }
+    if (vm.count("emit-obj")) {
+      ir_generator.emit_objects(output_file, backend_options);
     }
   }
 
@@ -82,6 +222,11 @@ int main(int argc, char **argv) {
       parser_driver.result_ast->accept(dumper);
     dumper.nl();
   }
-  delete parser_driver.result_ast;
+  // Once bound, the program belongs to main, and the passes may have
+  // replaced its root expression.
+  if (main)
+    delete main;
+  else
+    delete parser_driver.result_ast;
   return 0;
 }
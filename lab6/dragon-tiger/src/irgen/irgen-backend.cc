@@ -0,0 +1,362 @@
+#include "irgen.hh"
+#include "../utils/errors.hh"
+
+#include <algorithm>
+#include <thread>
+
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
+#if LLVM_VERSION_MAJOR < 4
+#include "llvm/Bitcode/ReaderWriter.h"
+#else
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#endif // LLVM_VERSION_MAJOR < 4
+#if LLVM_VERSION_MAJOR >= 4
+#include "llvm/Transforms/IPO/AlwaysInliner.h"
+#endif // LLVM_VERSION_MAJOR >= 4
+#if LLVM_VERSION_MAJOR < 14
+#include "llvm/Support/TargetRegistry.h"
+#else
+#include "llvm/MC/TargetRegistry.h"
+#endif // LLVM_VERSION_MAJOR < 14
+
+// Optimization and code generation of the generated module, which
+// replace running opt and llc on its bitcode.
+
+using utils::error;
+
+namespace irgen {
+
+namespace {
+
+llvm::CodeGenOpt::Level codegen_level(const BackendOptions &options) {
+  switch (options.opt_level) {
+  case 0:
+    return llvm::CodeGenOpt::None;
+  case 1:
+    return llvm::CodeGenOpt::Less;
+  case 2:
+    return llvm::CodeGenOpt::Default;
+  default:
+    return llvm::CodeGenOpt::Aggressive;
+  }
+}
+
+// Create the machine of the host target, or set failure and return
+// null if it is unknown.
+std::unique_ptr<llvm::TargetMachine>
+create_target_machine(const BackendOptions &options, std::string &failure) {
+  const std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::string message;
+  const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, message);
+  if (!target) {
+    failure = "cannot find target " + triple + ": " + message;
+    return nullptr;
+  }
+  return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+      triple, options.cpu, options.features, llvm::TargetOptions(),
+      llvm::Reloc::PIC_,
+#if LLVM_VERSION_MAJOR < 6
+      llvm::CodeModel::Default,
+#else
+      llvm::None,
+#endif // LLVM_VERSION_MAJOR < 6
+      codegen_level(options)));
+}
+
+// Run the function passes of the pipeline of the optimization level,
+// as opt would, and add its module passes to the given manager.
+void add_standard_passes(llvm::Module &module, llvm::TargetMachine &machine,
+                         const BackendOptions &options,
+                         llvm::legacy::PassManager &module_passes) {
+  // The builder owns the inliner and the library information. As with
+  // clang, only always-inline functions are inlined below -O2.
+  llvm::PassManagerBuilder builder;
+  builder.OptLevel = options.opt_level;
+  builder.SizeLevel = options.size_level;
+  if (options.opt_level > 1) {
+#if LLVM_VERSION_MAJOR < 5
+    builder.Inliner = llvm::createFunctionInliningPass(options.opt_level,
+                                                       options.size_level);
+#else
+    builder.Inliner = llvm::createFunctionInliningPass(
+        options.opt_level, options.size_level, false);
+#endif // LLVM_VERSION_MAJOR < 5
+  } else {
+#if LLVM_VERSION_MAJOR < 4
+    builder.Inliner = llvm::createAlwaysInlinerPass();
+#else
+    builder.Inliner = llvm::createAlwaysInlinerLegacyPass();
+#endif // LLVM_VERSION_MAJOR < 4
+  }
+  builder.LibraryInfo = new llvm::TargetLibraryInfoImpl(machine.getTargetTriple());
+  builder.LoopVectorize = options.opt_level > 1;
+  builder.SLPVectorize = options.opt_level > 1;
+  // The instrumented program writes its raw profile when it exits,
+  // through the profile runtime of LLVM. The merged profile gives the
+  // branch weights and entry counts used by the inliner, block
+  // placement and the splitting of hot and cold functions.
+  if (!options.profile_generate.empty()) {
+#if LLVM_VERSION_MAJOR >= 6
+    builder.EnablePGOInstrGen = true;
+#endif // LLVM_VERSION_MAJOR >= 6
+    builder.PGOInstrGen = options.profile_generate;
+  }
+  builder.PGOInstrUse = options.profile_use;
+#if LLVM_VERSION_MAJOR >= 5
+  machine.adjustPassManager(builder);
+#endif // LLVM_VERSION_MAJOR >= 5
+
+  llvm::legacy::FunctionPassManager function_passes(&module);
+  function_passes.add(
+      llvm::createTargetTransformInfoWrapperPass(machine.getTargetIRAnalysis()));
+  builder.populateFunctionPassManager(function_passes);
+  function_passes.doInitialization();
+  for (auto &function : module)
+    function_passes.run(function);
+  function_passes.doFinalization();
+
+  builder.populateModulePassManager(module_passes);
+}
+
+// Run a pipeline given in the syntax of opt -passes. Returns an error
+// message, empty on success.
+std::string run_pipeline(llvm::Module &module, llvm::TargetMachine &machine,
+                         const std::string &pipeline) {
+  llvm::PassBuilder builder(&machine);
+  llvm::LoopAnalysisManager loop_analyses;
+  llvm::FunctionAnalysisManager function_analyses;
+  llvm::CGSCCAnalysisManager cgscc_analyses;
+  llvm::ModuleAnalysisManager module_analyses;
+  builder.registerModuleAnalyses(module_analyses);
+  builder.registerCGSCCAnalyses(cgscc_analyses);
+  builder.registerFunctionAnalyses(function_analyses);
+  builder.registerLoopAnalyses(loop_analyses);
+  builder.crossRegisterProxies(loop_analyses, function_analyses,
+                               cgscc_analyses, module_analyses);
+
+  llvm::ModulePassManager passes;
+#if LLVM_VERSION_MAJOR < 7
+  if (!builder.parsePassPipeline(passes, pipeline))
+    return "invalid pass pipeline " + pipeline;
+#else
+  if (llvm::Error failure = builder.parsePassPipeline(passes, pipeline))
+    return "invalid pass pipeline " + pipeline + ": " +
+           llvm::toString(std::move(failure));
+#endif // LLVM_VERSION_MAJOR < 7
+  passes.run(module, module_analyses);
+  return "";
+}
+
+// Optimize a module, then compile it to object code into a buffer.
+// This only touches the context of the module, so that several
+// modules can be compiled in parallel. Returns an error message, empty
+// on success.
+std::string compile(llvm::Module &module, const BackendOptions &options,
+                    llvm::SmallVectorImpl<char> &object) {
+  std::string failure;
+  auto machine = create_target_machine(options, failure);
+  if (!machine)
+    return failure;
+  module.setTargetTriple(machine->getTargetTriple().str());
+  module.setDataLayout(machine->createDataLayout());
+
+  // The diagnostics are part of the message, so that threads do not
+  // write them concurrently.
+  std::string diagnostics;
+  llvm::raw_string_ostream diagnostics_stream(diagnostics);
+  if (options.verify && llvm::verifyModule(module, &diagnostics_stream))
+    return "invalid module " + module.getModuleIdentifier() + ":\n" +
+           diagnostics_stream.str();
+
+  llvm::legacy::PassManager module_passes;
+  module_passes.add(
+      llvm::createTargetTransformInfoWrapperPass(machine->getTargetIRAnalysis()));
+  if (options.passes.empty())
+    add_standard_passes(module, *machine, options, module_passes);
+  else if (!(failure = run_pipeline(module, *machine, options.passes)).empty())
+    return failure;
+
+  // The code generator verifies the optimized module first if asked to.
+  llvm::raw_svector_ostream OS(object);
+#if LLVM_VERSION_MAJOR < 7
+  const bool failed = machine->addPassesToEmitFile(
+      module_passes, OS, llvm::TargetMachine::CGFT_ObjectFile, !options.verify);
+#elif LLVM_VERSION_MAJOR < 10
+  const bool failed = machine->addPassesToEmitFile(
+      module_passes, OS, nullptr, llvm::TargetMachine::CGFT_ObjectFile,
+      !options.verify);
+#else
+  const bool failed = machine->addPassesToEmitFile(
+      module_passes, OS, nullptr, llvm::CGFT_ObjectFile, !options.verify);
+#endif // LLVM_VERSION_MAJOR < 7
+  if (failed)
+    return "cannot generate object code for " + module.getTargetTriple();
+  module_passes.run(module);
+  return "";
+}
+
+// The module holds the whole program, which is only entered through
+// main. Once everything else is internal, interprocedural constant
+// propagation and the removal of unused globals apply to it.
+void optimize_whole_program(llvm::Module &module) {
+  llvm::legacy::PassManager passes;
+  passes.add(llvm::createInternalizePass(
+      [](const llvm::GlobalValue &value) { return value.getName() == "main"; }));
+  passes.add(llvm::createIPSCCPPass());
+  passes.add(llvm::createGlobalDCEPass());
+  passes.run(module);
+}
+
+} // namespace
+
+void BackendOptions::target_host() {
+  cpu = llvm::sys::getHostCPUName().str();
+  // Features are sorted so that the generated code does not depend on
+  // the order of the map.
+  llvm::StringMap<bool> host_features;
+  std::vector<std::string> enabled;
+  if (llvm::sys::getHostCPUFeatures(host_features))
+    for (auto &feature : host_features)
+      enabled.push_back((feature.second ? "+" : "-") + feature.getKey().str());
+  std::sort(enabled.begin(), enabled.end());
+  features.clear();
+  for (auto &feature : enabled)
+    features += (features.empty() ? "" : ",") + feature;
+}
+
+void IRGenerator::set_target_attributes(const BackendOptions &options) {
+  for (auto &function : *Mod) {
+    if (function.isDeclaration())
+      continue;
+    function.addFnAttr("target-cpu", options.cpu);
+    if (options.features.empty())
+      function.removeFnAttr("target-features");
+    else
+      function.addFnAttr("target-features", options.features);
+  }
+}
+
+void IRGenerator::link_runtime(const std::string &filename) {
+  llvm::SMDiagnostic diagnostic;
+  std::unique_ptr<llvm::Module> runtime =
+      llvm::parseIRFile(filename, diagnostic, Context);
+  if (!runtime)
+    error("cannot read runtime " + filename + ": " +
+          diagnostic.getMessage().str());
+
+  // The program comes first: it has no target of its own and takes
+  // the triple and data layout of the runtime. Only the linked
+  // runtime symbols are internalized, main stays visible.
+  const bool failed = llvm::Linker::linkModules(
+      *Mod, std::move(runtime), llvm::Linker::Flags::LinkOnlyNeeded,
+      [](llvm::Module &module, const llvm::StringSet<> &linked) {
+        llvm::internalizeModule(module, [&linked](const llvm::GlobalValue &value) {
+          return !value.hasName() || !linked.count(value.getName());
+        });
+      });
+  if (failed)
+    error("cannot link runtime " + filename);
+}
+
+void IRGenerator::emit_objects(const std::string &filename,
+                               const BackendOptions &options) {
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  // This is done once, before the program is split into partitions.
+  set_target_attributes(options);
+  if (options.opt_level > 0 && options.passes.empty())
+    optimize_whole_program(*Mod);
+
+  const unsigned jobs = options.jobs;
+  if (jobs <= 1) {
+    llvm::SmallVector<char, 0> object;
+    const std::string failure = compile(*Mod, options, object);
+    if (!failure.empty())
+      error(failure);
+    open_output(filename, false)->write(object.data(), object.size());
+    return;
+  }
+
+  if (filename == "-")
+    error("partitions cannot be written to the standard output");
+
+  // Functions and global variables are assigned to partitions from a
+  // hash of their names, and internal ones referenced from another
+  // partition are made hidden instead. Each partition moves to its own
+  // context through bitcode, as a context cannot be shared between
+  // threads.
+  std::vector<llvm::SmallVector<char, 0>> partitions;
+  auto save_partition = [&partitions](std::unique_ptr<llvm::Module> partition) {
+    partitions.emplace_back();
+    llvm::raw_svector_ostream OS(partitions.back());
+#if LLVM_VERSION_MAJOR < 7
+    llvm::WriteBitcodeToFile(partition.get(), OS);
+#else
+    llvm::WriteBitcodeToFile(*partition, OS);
+#endif // LLVM_VERSION_MAJOR < 7
+  };
+#if LLVM_VERSION_MAJOR < 13
+  llvm::SplitModule(std::move(Mod), jobs, save_partition);
+#else
+  llvm::SplitModule(*Mod, jobs, save_partition);
+#endif // LLVM_VERSION_MAJOR < 13
+
+  // Threads record their failure, which is reported once all of them
+  // have been joined, as exiting would race with the running ones.
+  std::vector<llvm::SmallVector<char, 0>> objects(partitions.size());
+  std::vector<std::string> failures(partitions.size());
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < partitions.size(); i++)
+    threads.emplace_back([&partitions, &objects, &failures, &options, i]() {
+      llvm::LLVMContext context;
+      const llvm::MemoryBufferRef buffer(
+          llvm::StringRef(partitions[i].data(), partitions[i].size()),
+          "partition");
+      auto partition = llvm::parseBitcodeFile(buffer, context);
+#if LLVM_VERSION_MAJOR < 4
+      if (!partition) {
+        failures[i] = "cannot read partition: " + partition.getError().message();
+        return;
+      }
+#else
+      if (!partition) {
+        failures[i] =
+            "cannot read partition: " + llvm::toString(partition.takeError());
+        return;
+      }
+#endif // LLVM_VERSION_MAJOR < 4
+      failures[i] = compile(**partition, options, objects[i]);
+    });
+  for (auto &thread : threads)
+    thread.join();
+  for (auto &failure : failures)
+    if (!failure.empty())
+      error(failure);
+
+  // Objects are written once all are compiled, in partition order, so
+  // that the output does not depend on thread scheduling.
+  for (unsigned i = 0; i < objects.size(); i++)
+    open_output(filename + "." + std::to_string(i), false)
+        ->write(objects[i].data(), objects[i].size());
+}
+
+} // namespace irgen
@@ -0,0 +1,145 @@
+#include "irgen.hh"
+
+#include <algorithm>
+
+#include "llvm/Config/llvm-config.h"
+#if LLVM_VERSION_MAJOR < 5
+#include "llvm/Support/Dwarf.h"
+#else
+#include "llvm/BinaryFormat/Dwarf.h"
+#endif // LLVM_VERSION_MAJOR < 5
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+// DWARF debug information built from the locations of the AST nodes,
+// so that debuggers and profilers refer to Tiger functions, lines and
+// variables.
+
+namespace irgen {
+
+void IRGenerator::enable_debug_info(const std::string &filename) {
+  llvm::SmallString<128> directory;
+  llvm::sys::fs::current_path(directory);
+  DBuilder = llvm::make_unique<llvm::DIBuilder>(*Mod);
+  debug_file = DBuilder->createFile(filename == "-" ? "<stdin>" : filename,
+                                    directory);
+  // DWARF has no language code for Tiger, C is the closest one for
+  // debuggers.
+  DBuilder->createCompileUnit(llvm::dwarf::DW_LANG_C, debug_file, "dtiger",
+                              false, "", 0);
+  Mod->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                     llvm::DEBUG_METADATA_VERSION);
+  Mod->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+}
+
+llvm::DIType *IRGenerator::debug_type(const ast::Type type) {
+  switch (type) {
+  case t_int:
+#if LLVM_VERSION_MAJOR < 4
+    return DBuilder->createBasicType("int", 32, 32, llvm::dwarf::DW_ATE_signed);
+#else
+    return DBuilder->createBasicType("int", 32, llvm::dwarf::DW_ATE_signed);
+#endif // LLVM_VERSION_MAJOR < 4
+  case t_string:
+    return DBuilder->createPointerType(
+#if LLVM_VERSION_MAJOR < 4
+        DBuilder->createBasicType("char", 8, 8, llvm::dwarf::DW_ATE_signed_char),
+#else
+        DBuilder->createBasicType("char", 8, llvm::dwarf::DW_ATE_signed_char),
+#endif // LLVM_VERSION_MAJOR < 4
+        Mod->getDataLayout().getPointerSizeInBits());
+  case t_void:
+    return nullptr;
+  default:
+    assert(false); __builtin_unreachable();
+  }
+}
+
+void IRGenerator::debug_function(const FunDecl &decl, llvm::Function *function) {
+  if (!DBuilder)
+    return;
+
+  // The static link is not part of the Tiger signature.
+  std::vector<llvm::Metadata *> types = {debug_type(decl.get_type())};
+  for (auto param : decl.get_params())
+    types.push_back(debug_type(param->get_type()));
+  llvm::DISubroutineType *type =
+      DBuilder->createSubroutineType(DBuilder->getOrCreateTypeArray(types));
+
+  // The subprogram has the Tiger name, the symbol keeps the unique
+  // external name.
+  const unsigned line = decl.loc.begin.line;
+#if LLVM_VERSION_MAJOR < 8
+  llvm::DISubprogram *subprogram = DBuilder->createFunction(
+      debug_file, decl.name.get(), decl.get_external_name().get(), debug_file,
+      line, type, !decl.is_external, true, line, llvm::DINode::FlagPrototyped);
+#else
+  llvm::DISubprogram *subprogram = DBuilder->createFunction(
+      debug_file, decl.name.get(), decl.get_external_name().get(), debug_file,
+      line, type, line, llvm::DINode::FlagPrototyped,
+      decl.is_external ? llvm::DISubprogram::SPFlagDefinition
+                       : llvm::DISubprogram::SPFlagDefinition |
+                             llvm::DISubprogram::SPFlagLocalToUnit);
+#endif // LLVM_VERSION_MAJOR < 8
+  function->setSubprogram(subprogram);
+}
+
+llvm::DILocalVariable *IRGenerator::debug_variable(const VarDecl &decl) {
+  llvm::DILocalVariable *&variable = debug_variables[&decl];
+  if (variable)
+    return variable;
+
+  const std::vector<VarDecl *> &params = current_function_decl->get_params();
+  const auto param = std::find(params.begin(), params.end(), &decl);
+  const unsigned line = decl.loc.begin.line;
+  if (param != params.end())
+    variable = DBuilder->createParameterVariable(
+        debug_subprogram, decl.name.get(), param - params.begin() + 1,
+        debug_file, line, debug_type(decl.get_type()));
+  else
+    variable = DBuilder->createAutoVariable(debug_subprogram, decl.name.get(),
+                                            debug_file, line,
+                                            debug_type(decl.get_type()));
+  return variable;
+}
+
+void IRGenerator::debug_declare(const VarDecl &decl, llvm::Value *address) {
+  if (!DBuilder)
+    return;
+  DBuilder->insertDeclare(
+      address, debug_variable(decl), DBuilder->createExpression(),
+      llvm::DILocation::get(Context, decl.loc.begin.line,
+                            decl.loc.begin.column, debug_subprogram),
+      Builder.GetInsertBlock());
+}
+
+void IRGenerator::debug_value(const VarDecl &decl, llvm::Value *value) {
+  if (!DBuilder || !value)
+    return;
+#if LLVM_VERSION_MAJOR < 6
+  DBuilder->insertDbgValueIntrinsic(
+      value, 0, debug_variable(decl), DBuilder->createExpression(),
+#else
+  DBuilder->insertDbgValueIntrinsic(
+      value, debug_variable(decl), DBuilder->createExpression(),
+#endif // LLVM_VERSION_MAJOR < 6
+      llvm::DILocation::get(Context, decl.loc.begin.line,
+                            decl.loc.begin.column, debug_subprogram),
+      Builder.GetInsertBlock());
+}
+
+IRGenerator::LocationScope::LocationScope(IRGenerator &generator,
+                                          const Node &node)
+    : generator(generator), saved(generator.Builder.getCurrentDebugLocation()) {
+  // Nodes visited outside of any function, such as main, have no scope.
+  if (generator.debug_subprogram)
+    generator.Builder.SetCurrentDebugLocation(llvm::DILocation::get(
+        generator.Context, node.loc.begin.line, node.loc.begin.column,
+        generator.debug_subprogram));
+}
+
+IRGenerator::LocationScope::~LocationScope() {
+  generator.Builder.SetCurrentDebugLocation(saved);
+}
+
+} // namespace irgen
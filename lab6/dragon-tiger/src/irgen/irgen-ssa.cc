@@ -0,0 +1,96 @@
+#include "irgen.hh"
+
+#include "llvm/IR/CFG.h"
+
+// On-the-fly SSA construction for the variables which are not stored
+// in a frame, following Braun et al., "Simple and Efficient Construction
+// of Static Single Assignment Form" (CC 2013). Reading a variable in a
+// block whose predecessors are not all known yet inserts an incomplete
+// phi, which gets its operands when the block is sealed.
+
+namespace irgen {
+
+void IRGenerator::write_variable(const VarDecl &decl, llvm::BasicBlock *block,
+                                 llvm::Value *value) {
+  current_def[block][&decl] = value;
+}
+
+llvm::Value *IRGenerator::read_variable(const VarDecl &decl,
+                                        llvm::BasicBlock *block) {
+  auto defs = current_def.find(block);
+  if (defs != current_def.end()) {
+    auto def = defs->second.find(&decl);
+    if (def != defs->second.end())
+      return def->second;
+  }
+  return read_variable_recursive(decl, block);
+}
+
+llvm::PHINode *IRGenerator::new_phi(const VarDecl &decl,
+                                    llvm::BasicBlock *block) {
+  llvm::Type *type = llvm_type(decl.get_type());
+  if (llvm::Instruction *first = block->getFirstNonPHI())
+    return llvm::PHINode::Create(type, 2, decl.name.get(), first);
+  return llvm::PHINode::Create(type, 2, decl.name.get(), block);
+}
+
+llvm::Value *IRGenerator::read_variable_recursive(const VarDecl &decl,
+                                                  llvm::BasicBlock *block) {
+  llvm::Value *value;
+  if (!sealed_blocks.count(block)) {
+    llvm::PHINode *phi = new_phi(decl, block);
+    incomplete_phis[block].push_back(std::make_pair(&decl, phi));
+    value = phi;
+  } else if (llvm::BasicBlock *pred = block->getSinglePredecessor()) {
+    value = read_variable(decl, pred);
+  } else if (llvm::pred_begin(block) == llvm::pred_end(block)) {
+    // Unreachable code, such as the code following a break.
+    value = llvm::UndefValue::get(llvm_type(decl.get_type()));
+  } else {
+    // The phi is recorded first to break cycles through loops.
+    llvm::PHINode *phi = new_phi(decl, block);
+    write_variable(decl, block, phi);
+    value = add_phi_operands(decl, phi);
+  }
+  write_variable(decl, block, value);
+  return value;
+}
+
+llvm::Value *IRGenerator::add_phi_operands(const VarDecl &decl,
+                                           llvm::PHINode *phi) {
+  for (llvm::BasicBlock *pred : llvm::predecessors(phi->getParent()))
+    phi->addIncoming(read_variable(decl, pred), pred);
+  return try_remove_trivial_phi(phi);
+}
+
+llvm::Value *IRGenerator::try_remove_trivial_phi(llvm::PHINode *phi) {
+  llvm::Value *same = nullptr;
+  for (llvm::Value *op : phi->incoming_values()) {
+    if (op == same || op == phi)
+      continue;
+    if (same)
+      return phi;
+    same = op;
+  }
+  if (!same)
+    same = llvm::UndefValue::get(phi->getType());
+
+  // The definitions of the variables are updated along with the uses.
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
+  return same;
+}
+
+void IRGenerator::seal_block(llvm::BasicBlock *block) {
+  auto phis = incomplete_phis.find(block);
+  if (phis != incomplete_phis.end()) {
+    // Completing the phis may create incomplete phis in other blocks.
+    auto pending = std::move(phis->second);
+    incomplete_phis.erase(phis);
+    for (auto &phi : pending)
+      add_phi_operands(*phi.first, phi.second);
+  }
+  sealed_blocks.insert(block);
+}
+
+} // namespace irgen
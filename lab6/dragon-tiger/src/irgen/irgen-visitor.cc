@@ -2,6 +2,8 @@
 #include <iostream> // For std::cerr
 #include "irgen.hh"
 
+#include "llvm/IR/CFG.h"
+
 #include "llvm/Support/raw_ostream.h"
 
 namespace {
@@ -17,24 +19,60 @@ namespace {
 namespace irgen {
 
 llvm::Value *IRGenerator::visit(const IntegerLiteral &literal) {
+  LocationScope location(*this, literal);
   return Builder.getInt32(literal.value);
 }
 
 llvm::Value *IRGenerator::visit(const StringLiteral &literal) {
-  return Builder.CreateGlobalStringPtr(literal.value.get());
+  LocationScope location(*this, literal);
+  llvm::Value *&constant = string_constants[literal.value];
+  if (!constant)
+    constant = Builder.CreateGlobalStringPtr(literal.value.get(), "str");
+  return constant;
 }
 
 llvm::Value *IRGenerator::visit(const Break &b) {
+  LocationScope location(*this, b);
   llvm::BasicBlock *after_break =
     llvm::BasicBlock::Create(Context, "break_deprecated", current_function);
 
   Builder.CreateBr(loop_exit_bbs[&b.get_loop().get()]);
 
   Builder.SetInsertPoint(after_break);
+  seal_block(after_break);
   return nullptr;
 }
 
 llvm::Value *IRGenerator::visit(const BinaryOperator &op) {
+  LocationScope location(*this, op);
+  if (op.op == o_and || op.op == o_or) {
+    // The right operand is only evaluated if the left one does not
+    // decide the result, which is known in every other predecessor.
+    llvm::BasicBlock *const rhs_block = llvm::BasicBlock::Create(
+        Context, op.op == o_and ? "and_rhs" : "or_rhs", current_function);
+    llvm::BasicBlock *const end_block =
+        llvm::BasicBlock::Create(Context, "logic_end", current_function);
+
+    if (op.op == o_and)
+      generate_condition(op.get_left(), rhs_block, end_block);
+    else
+      generate_condition(op.get_left(), end_block, rhs_block);
+
+    Builder.SetInsertPoint(rhs_block);
+    seal_block(rhs_block);
+    llvm::Value *r = Builder.CreateICmpNE(op.get_right().accept(*this),
+                                          Builder.getInt32(0));
+    llvm::BasicBlock *const rhs_end = Builder.GetInsertBlock();
+    Builder.CreateBr(end_block);
+
+    Builder.SetInsertPoint(end_block);
+    seal_block(end_block);
+    llvm::PHINode *phi = Builder.CreatePHI(Builder.getInt1Ty(), 2);
+    for (llvm::BasicBlock *pred : llvm::predecessors(end_block))
+      phi->addIncoming(pred == rhs_end ? r : Builder.getInt1(op.op == o_or), pred);
+    return Builder.CreateIntCast(phi, Builder.getInt32Ty(), false);
+  }
+
   // Void values can be compared for equality only. We directly
   // return 1 or 0 depending on the equality/inequality operator.
   if (op.get_left().get_type() == t_void) {
@@ -45,12 +83,8 @@ llvm::Value *IRGenerator::visit(const BinaryOperator &op) {
   llvm::Value *r = op.get_right().accept(*this);
 
   if (op.get_left().get_type() == t_string) {
-    auto const strcmp = Mod->getOrInsertFunction("__strcmp", Builder.getInt32Ty(),
-        Builder.getInt8PtrTy(), Builder.getInt8PtrTy()
-#if LLVM_VERSION_MAJOR < 5
-        , nullptr  // Older versions of LLVM uses C-vararg with a NULL end sigil
-#endif // LLVM_MAJOR_VERSION < 5
-        );
+    llvm::Function *const strcmp =
+        declare_primitive(*ast::primitives::find(Symbol("strcmp")));
     l = Builder.CreateCall(strcmp, {l, r});
     r = Builder.getInt32(0);
   }
@@ -81,6 +115,7 @@ llvm::Value *IRGenerator::visit(const BinaryOperator &op) {
 }
 
 llvm::Value *IRGenerator::visit(const Sequence &seq) {
+  LocationScope location(*this, seq);
   llvm::Value *result = nullptr;
   for (auto expr : seq.get_exprs())
     result = expr->accept(*this);
@@ -91,6 +126,7 @@ llvm::Value *IRGenerator::visit(const Sequence &seq) {
 }
 
 llvm::Value *IRGenerator::visit(const Let &let) {
+  LocationScope location(*this, let);
   for (auto decl : let.get_decls())
     decl->accept(*this);
 
@@ -98,11 +134,24 @@ llvm::Value *IRGenerator::visit(const Let &let) {
 }
 
 llvm::Value *IRGenerator::visit(const Identifier &id) {
+  LocationScope location(*this, id);
+  const VarDecl &decl = id.get_decl().get();
+  if (decl.get_type() == t_void)
+    return nullptr;
+
+  auto ssa_value = ssa_values.find(&decl);
+  if (ssa_value != ssa_values.end())
+    return ssa_value->second;
+
+  if (is_ssa(decl))
+    return read_variable(decl, Builder.GetInsertBlock());
+
   llvm::Value *reg = Builder.CreateLoad(address_of(id));
   return reg;
 }
 
 llvm::Value *IRGenerator::visit(const IfThenElse &ite) {
+  LocationScope location(*this, ite);
   llvm::BasicBlock *const if_then =
       llvm::BasicBlock::Create(Context, "if_then", current_function);
   llvm::BasicBlock *const if_else =
@@ -110,53 +159,65 @@ llvm::Value *IRGenerator::visit(const IfThenElse &ite) {
   llvm::BasicBlock *const if_end =
       llvm::BasicBlock::Create(Context, "if_end", current_function);
 
-  bool void_ite = ite.get_then_part().get_type() == t_void;
-
-  llvm::Value *result;
-  llvm::Value *value;
-
-  if (!void_ite)
-    result = alloca_in_entry(llvm_type(t_int), "result");
-
-  Builder.CreateCondBr(Builder.CreateICmpNE(ite.get_condition().accept(*this), Builder.getInt32(0)),
-                        if_then, if_else);
+  generate_condition(ite.get_condition(), if_then, if_else);
+  seal_block(if_then);
+  seal_block(if_else);
 
   Builder.SetInsertPoint(if_then);
-  value = ite.get_then_part().accept(*this);
-  if (!void_ite)
-    Builder.CreateStore(value, result);
+  llvm::Value *const then_value = ite.get_then_part().accept(*this);
+  llvm::BasicBlock *const then_end = Builder.GetInsertBlock();
   Builder.CreateBr(if_end);
 
   Builder.SetInsertPoint(if_else);
-  value = ite.get_else_part().accept(*this);
-  if (!void_ite)
-    Builder.CreateStore(value, result);
+  llvm::Value *const else_value = ite.get_else_part().accept(*this);
+  llvm::BasicBlock *const else_end = Builder.GetInsertBlock();
   Builder.CreateBr(if_end);
 
   Builder.SetInsertPoint(if_end);
+  seal_block(if_end);
 
-  if (!void_ite)
-    return Builder.CreateLoad(result);
-  return nullptr;
+  if (ite.get_type() == t_void)
+    return nullptr;
+
+  llvm::PHINode *const result =
+      Builder.CreatePHI(llvm_type(ite.get_type()), 2, "result");
+  result->addIncoming(then_value, then_end);
+  result->addIncoming(else_value, else_end);
+  return result;
 }
 
 llvm::Value *IRGenerator::visit(const VarDecl &decl) {
+  LocationScope location(*this, decl);
+  llvm::Value *value =
+      decl.get_expr() ? decl.get_expr()->accept(*this) : nullptr;
   if (decl.get_type() == t_void)
     return nullptr;
 
-  llvm::Value *variable = generate_vardecl(decl);
-  if (decl.get_expr()) {
-    llvm::Value *value = decl.get_expr()->accept(*this);
-    Builder.CreateStore(value, variable);
+  if (is_ssa(decl)) {
+    if (value) {
+      write_variable(decl, Builder.GetInsertBlock(), value);
+      debug_value(decl, value);
+    }
+    return value;
   }
 
+  llvm::Value *variable = generate_vardecl(decl);
+  if (value)
+    Builder.CreateStore(value, variable);
   return variable;
 }
 
 llvm::Value *IRGenerator::visit(const FunDecl &decl) {
+  LocationScope location(*this, decl);
+  // Primitives are the only functions without a body.
+  if (!decl.get_expr()) {
+    declare_primitive(*ast::primitives::find_external(decl.get_external_name()));
+    return nullptr;
+  }
+
   std::vector<llvm::Type *> param_types;
 
-  if (!decl.is_external) {
+  if (decl.get_needs_static_link()) {
     param_types.push_back(frame_type[&decl.get_parent().get()]->getPointerTo());
   }
   for (auto param_decl : decl.get_params()) {
@@ -168,18 +229,30 @@ llvm::Value *IRGenerator::visit(const FunDecl &decl) {
   llvm::FunctionType *ft =
       llvm::FunctionType::get(return_type, param_types, false);
 
-  llvm::Function::Create(ft,
-                         decl.is_external ? llvm::Function::ExternalLinkage
-                                          : llvm::Function::InternalLinkage,
-                         decl.get_external_name().get(), Mod.get());
-
-  if (decl.get_expr())
-    pending_func_bodies.push_front(&decl);
+  llvm::Function *function = llvm::Function::Create(
+      ft,
+      decl.is_external ? llvm::Function::ExternalLinkage
+                       : llvm::Function::InternalLinkage,
+      decl.get_external_name().get(), Mod.get());
+  debug_function(decl, function);
+
+  // Internal functions are only called from Tiger code, so they can
+  // use the fast calling convention. The static link gets the register
+  // reserved for static chains.
+  if (!decl.is_external)
+    function->setCallingConv(llvm::CallingConv::Fast);
+#if LLVM_VERSION_MAJOR >= 5
+  if (decl.get_needs_static_link())
+    function->arg_begin()->addAttr(llvm::Attribute::Nest);
+#endif // LLVM_VERSION_MAJOR >= 5
+
+  pending_func_bodies.push_front(&decl);
 
   return nullptr;
 }
 
 llvm::Value *IRGenerator::visit(const FunCall &call) {
+  LocationScope location(*this, call);
   // Look up the name in the global module table.
   const FunDecl &decl = call.get_decl().get();
   llvm::Function *callee =
@@ -193,22 +266,66 @@ llvm::Value *IRGenerator::visit(const FunCall &call) {
     callee = Mod->getFunction(decl.get_external_name().get());
   }
 
+  const bool tail_call = tail_calls.count(&call);
+  if (tail_call && &decl == current_function_decl) {
+    // All the arguments are evaluated before any parameter is updated,
+    // as they may refer to the current parameter values. The static
+    // link and the frame are left unchanged.
+    std::vector<llvm::Value *> args_values;
+    for (auto expr : call.get_args())
+      args_values.push_back(expr->accept(*this));
+    for (unsigned i = 0; i < args_values.size(); i++) {
+      const VarDecl &param = *decl.get_params()[i];
+      if (is_ssa(param)) {
+        write_variable(param, Builder.GetInsertBlock(), args_values[i]);
+        debug_value(param, args_values[i]);
+      } else
+        Builder.CreateStore(args_values[i], allocations[&param]);
+    }
+    Builder.CreateBr(tail_entry);
+    return continue_after_tail_call(decl.get_type());
+  }
+
   std::vector<llvm::Value *> args_values;
-  if (!decl.is_external) {
-    args_values.push_back(frame_up(call.get_depth() - decl.get_depth()).second);
+  // A tail call must not receive the current frame, which would be
+  // gone by the time the callee uses it.
+  bool passes_frame = false;
+  if (decl.get_needs_static_link()) {
+    // The static link is the frame of the callee's parent, which is
+    // declared one level above the callee body.
+    const int levels = call.get_depth() - decl.get_depth() + 1;
+    passes_frame = levels == 0;
+    args_values.push_back(frame_up(levels).second);
   }
   for (auto expr : call.get_args()) {
     args_values.push_back(expr->accept(*this));
   }
 
-  if (decl.get_type() == t_void) {
-    Builder.CreateCall(callee, args_values);
-    return nullptr;
+  llvm::CallInst *const result = decl.get_type() == t_void
+      ? Builder.CreateCall(callee, args_values)
+      : Builder.CreateCall(callee, args_values, "call");
+  result->setCallingConv(callee->getCallingConv());
+  if (!tail_call || passes_frame)
+    return decl.get_type() == t_void ? nullptr : result;
+
+  // A tail call to a function of the same type and calling convention
+  // is guaranteed to reuse the frame if it returns right away, which it
+  // does even when in a branch of a conditional.
+  if (callee->getFunctionType() != current_function->getFunctionType() ||
+      callee->getCallingConv() != current_function->getCallingConv()) {
+    result->setTailCall();
+    return decl.get_type() == t_void ? nullptr : result;
   }
-  return Builder.CreateCall(callee, args_values, "call");
+  result->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  if (decl.get_type() == t_void)
+    Builder.CreateRetVoid();
+  else
+    Builder.CreateRet(result);
+  return continue_after_tail_call(decl.get_type());
 }
 
 llvm::Value *IRGenerator::visit(const WhileLoop &loop) {
+  LocationScope location(*this, loop);
   llvm::BasicBlock *const test_block =
     llvm::BasicBlock::Create(Context, "loop_test", current_function);
   llvm::BasicBlock *const body_block =
@@ -220,49 +337,83 @@ llvm::Value *IRGenerator::visit(const WhileLoop &loop) {
 
   Builder.CreateBr(test_block);
 
+  // The test block is sealed once the back edge exists, and the end
+  // block once every break has been seen.
   Builder.SetInsertPoint(test_block);
-  Builder.CreateCondBr(Builder.CreateICmpNE(loop.get_condition().accept(*this), Builder.getInt32(0)),
-  body_block, end_block);
+  generate_condition(loop.get_condition(), body_block, end_block);
+  seal_block(body_block);
 
   Builder.SetInsertPoint(body_block);
   loop.get_body().accept(*this);
   Builder.CreateBr(test_block);
+  seal_block(test_block);
 
   Builder.SetInsertPoint(end_block);
+  seal_block(end_block);
   return nullptr;
 }
 
 llvm::Value *IRGenerator::visit(const ForLoop &loop) {
-  llvm::BasicBlock *const test_block =
-      llvm::BasicBlock::Create(Context, "loop_test", current_function);
+  LocationScope location(*this, loop);
   llvm::BasicBlock *const body_block =
       llvm::BasicBlock::Create(Context, "loop_body", current_function);
+  llvm::BasicBlock *const latch_block =
+      llvm::BasicBlock::Create(Context, "loop_latch", current_function);
   llvm::BasicBlock *const end_block =
       llvm::BasicBlock::Create(Context, "loop_end", current_function);
-  llvm::Value *const index = loop.get_variable().accept(*this);
+  const VarDecl &variable = loop.get_variable();
+  llvm::Value *const low = variable.get_expr()->accept(*this);
   llvm::Value *const high = loop.get_high().accept(*this);
 
-  loop_exit_bbs[&loop] = end_block;
+  // The index cannot be assigned, so it lives in a phi. It is only
+  // copied into the frame if a nested function reads it.
+  llvm::Value *const slot =
+      variable.get_escapes() ? generate_vardecl(variable) : nullptr;
 
-  Builder.CreateBr(test_block);
+  loop_exit_bbs[&loop] = end_block;
 
-  Builder.SetInsertPoint(test_block);
-  Builder.CreateCondBr(Builder.CreateICmpSLE(Builder.CreateLoad(index), high),
-                       body_block, end_block);
+  llvm::BasicBlock *const pre_block = Builder.GetInsertBlock();
+  Builder.CreateCondBr(Builder.CreateICmpSLE(low, high), body_block, end_block);
 
   Builder.SetInsertPoint(body_block);
+  llvm::PHINode *const index =
+      Builder.CreatePHI(Builder.getInt32Ty(), 2, variable.name.get());
+  index->addIncoming(low, pre_block);
+  if (slot) {
+    Builder.CreateStore(index, slot);
+  } else {
+    ssa_values[&variable] = index;
+    debug_value(variable, index);
+  }
   loop.get_body().accept(*this);
-  Builder.CreateStore(
-      Builder.CreateAdd(Builder.CreateLoad(index), Builder.getInt32(1)), index);
-  Builder.CreateBr(test_block);
+  Builder.CreateBr(latch_block);
+  seal_block(latch_block);
+
+  // The index is only incremented while it is below the high bound,
+  // so the increment never overflows.
+  Builder.SetInsertPoint(latch_block);
+  llvm::Value *const more = Builder.CreateICmpSLT(index, high);
+  llvm::Value *const next = Builder.CreateNSWAdd(index, Builder.getInt32(1));
+  index->addIncoming(next, latch_block);
+  Builder.CreateCondBr(more, body_block, end_block);
+  seal_block(body_block);
 
   Builder.SetInsertPoint(end_block);
+  seal_block(end_block);
   return nullptr;
 }
 
 llvm::Value *IRGenerator::visit(const Assign &assign) {
+  LocationScope location(*this, assign);
   llvm::Value *value = assign.get_rhs().accept(*this);
-  Builder.CreateStore(value, address_of(assign.get_lhs()));
+  const VarDecl &decl = assign.get_lhs().get_decl().get();
+  if (decl.get_type() == t_void)
+    return nullptr;
+  if (is_ssa(decl)) {
+    write_variable(decl, Builder.GetInsertBlock(), value);
+    debug_value(decl, value);
+  } else
+    Builder.CreateStore(value, address_of(assign.get_lhs()));
   return nullptr;
 }
 
@@ -1,14 +1,23 @@
 #include "irgen.hh"
 #include "../utils/errors.hh"
 
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/Verifier.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
+#if LLVM_VERSION_MAJOR < 4
+#include "llvm/Bitcode/ReaderWriter.h"
+#else
+#include "llvm/Bitcode/BitcodeWriter.h"
+#endif // LLVM_VERSION_MAJOR < 4
 
 using utils::error;
 
 namespace irgen {
 
-IRGenerator::IRGenerator() : Builder(Context) {
+IRGenerator::IRGenerator()
+    : Builder(Context), verify(false), debug_file(nullptr),
+      debug_subprogram(nullptr) {
   Mod = llvm::make_unique<llvm::Module>("tiger", Context);
 }
 
@@ -25,6 +34,61 @@ llvm::Type *IRGenerator::llvm_type(const ast::Type ast_type) {
   }
 }
 
+llvm::Function *
+IRGenerator::declare_primitive(const ast::primitives::Primitive &primitive) {
+  const std::string name = ast::primitives::external_name(primitive).get();
+  if (llvm::Function *function = Mod->getFunction(name))
+    return function;
+
+  auto type_of = [this](const char *type_name) -> llvm::Type * {
+    if (!type_name)
+      return Builder.getVoidTy();
+    if (std::string(type_name) == "int")
+      return Builder.getInt32Ty();
+    return Builder.getInt8PtrTy();
+  };
+  std::vector<llvm::Type *> param_types;
+  for (const char *type_name : primitive.param_types)
+    param_types.push_back(type_of(type_name));
+  llvm::FunctionType *ft = llvm::FunctionType::get(
+      type_of(primitive.type_name), param_types, false);
+  llvm::Function *function = llvm::Function::Create(
+      ft, llvm::Function::ExternalLinkage, name, Mod.get());
+
+#if LLVM_VERSION_MAJOR >= 5
+  // The runtime is written in C and never unwinds. Strings are never
+  // modified nor kept by the runtime.
+  function->addFnAttr(llvm::Attribute::NoUnwind);
+  switch (primitive.memory) {
+  case ast::primitives::m_none:
+    function->addFnAttr(llvm::Attribute::ReadNone);
+    break;
+  case ast::primitives::m_read_args:
+    function->addFnAttr(llvm::Attribute::ReadOnly);
+    function->addFnAttr(llvm::Attribute::ArgMemOnly);
+    break;
+  case ast::primitives::m_read:
+    function->addFnAttr(llvm::Attribute::ReadOnly);
+    break;
+  case ast::primitives::m_any:
+    break;
+  }
+  if (primitive.noreturn)
+    function->addFnAttr(llvm::Attribute::NoReturn);
+  if (primitive.allocates)
+    function->addAttribute(llvm::AttributeList::ReturnIndex,
+                           llvm::Attribute::NoAlias);
+  for (auto &arg : function->args()) {
+    if (arg.getType()->isPointerTy()) {
+      arg.addAttr(llvm::Attribute::NoCapture);
+      arg.addAttr(llvm::Attribute::ReadOnly);
+    }
+  }
+#endif // LLVM_VERSION_MAJOR >= 5
+
+  return function;
+}
+
 llvm::Value *IRGenerator::alloca_in_entry(llvm::Type *Ty,
                                           const std::string &name) {
   llvm::IRBuilderBase::InsertPoint const saved = Builder.saveIP();
@@ -34,14 +98,59 @@ llvm::Value *IRGenerator::alloca_in_entry(llvm::Type *Ty,
   return value;
 }
 
-void IRGenerator::print_ir(std::ostream *ostream) {
-  // FIXME: This is inefficient. Should probably take a filename
-  // and use directly LLVM raw stream interface
-  std::string buffer;
-  llvm::raw_string_ostream OS(buffer);
-  OS << *Mod;
-  OS.flush();
-  *ostream << buffer;
+std::unique_ptr<llvm::raw_fd_ostream>
+IRGenerator::open_output(const std::string &filename, bool text) {
+#if LLVM_VERSION_MAJOR < 9
+  const llvm::sys::fs::OpenFlags flags =
+      text ? llvm::sys::fs::F_Text : llvm::sys::fs::F_None;
+#else
+  const llvm::sys::fs::OpenFlags flags =
+      text ? llvm::sys::fs::OF_Text : llvm::sys::fs::OF_None;
+#endif // LLVM_VERSION_MAJOR < 9
+  std::error_code error_code;
+  auto OS = llvm::make_unique<llvm::raw_fd_ostream>(filename, error_code, flags);
+  if (error_code)
+    error("cannot open " + filename + ": " + error_code.message());
+  return OS;
+}
+
+void IRGenerator::print_ir(const std::string &filename) {
+  // The module is printed as it goes, without any intermediate copy.
+  auto OS = open_output(filename, true);
+  *OS << *Mod;
+}
+
+void IRGenerator::emit_bitcode(const std::string &filename) {
+  auto OS = open_output(filename, false);
+#if LLVM_VERSION_MAJOR < 7
+  llvm::WriteBitcodeToFile(Mod.get(), *OS);
+#else
+  llvm::WriteBitcodeToFile(*Mod, *OS);
+#endif // LLVM_VERSION_MAJOR < 7
+}
+
+void IRGenerator::generate_condition(const Expr &condition,
+                                     llvm::BasicBlock *if_true,
+                                     llvm::BasicBlock *if_false) {
+  auto op = dynamic_cast<const BinaryOperator *>(&condition);
+  if (op && op->op == o_and) {
+    llvm::BasicBlock *const rhs_block =
+        llvm::BasicBlock::Create(Context, "and_rhs", current_function);
+    generate_condition(op->get_left(), rhs_block, if_false);
+    Builder.SetInsertPoint(rhs_block);
+    seal_block(rhs_block);
+    generate_condition(op->get_right(), if_true, if_false);
+  } else if (op && op->op == o_or) {
+    llvm::BasicBlock *const rhs_block =
+        llvm::BasicBlock::Create(Context, "or_rhs", current_function);
+    generate_condition(op->get_left(), if_true, rhs_block);
+    Builder.SetInsertPoint(rhs_block);
+    seal_block(rhs_block);
+    generate_condition(op->get_right(), if_true, if_false);
+  } else {
+    Builder.CreateCondBr(Builder.CreateICmpNE(condition.accept(*this), Builder.getInt32(0)),
+                         if_true, if_false);
+  }
 }
 
 llvm::Value *IRGenerator::address_of(const Identifier &id) {
@@ -64,11 +173,19 @@ void IRGenerator::generate_program(FunDecl *main) {
     generate_function(*pending_func_bodies.back());
     pending_func_bodies.pop_back();
   }
+
+  if (DBuilder)
+    DBuilder->finalize();
 }
 
 void IRGenerator::generate_function(const FunDecl &decl) {
   // Reinitialize common structures.
   allocations.clear();
+  ssa_values.clear();
+  outer_frames.clear();
+  current_def.clear();
+  sealed_blocks.clear();
+  incomplete_phis.clear();
   loop_exit_bbs.clear();
 
   // Set current function
@@ -76,6 +193,10 @@ void IRGenerator::generate_function(const FunDecl &decl) {
   current_function_decl = &decl;
   std::vector<VarDecl *> params = decl.get_params();
 
+  // The prologue and the epilogue get the location of the declaration.
+  debug_subprogram = current_function->getSubprogram();
+  LocationScope location(*this, decl);
+
   // Create a new basic block to insert allocation insertion
   llvm::BasicBlock *bb1 =
       llvm::BasicBlock::Create(Context, "entry", current_function);
@@ -88,22 +209,43 @@ void IRGenerator::generate_function(const FunDecl &decl) {
       llvm::BasicBlock::Create(Context, "body", current_function);
 
   Builder.SetInsertPoint(bb2);
+  seal_block(bb2);
 
-  // Set the name for each argument and register it in the allocations map
-  // after storing it in an alloca.
+  // Set the name for each argument, and store it in the frame if it
+  // escapes.
+  static_link = nullptr;
   unsigned i = 0;
   for (auto &arg : current_function->args()) {
-    if (!decl.is_external && &arg == current_function->args().begin()) {
+    if (decl.get_needs_static_link() && &arg == current_function->args().begin()) {
       arg.setName("sl");
-      Builder.CreateStore(&arg, Builder.CreateStructGEP(frame, 0));
+      static_link = &arg;
+      if (decl.get_stores_static_link())
+        Builder.CreateStore(&arg, Builder.CreateStructGEP(frame, 0));
       continue;
     }
     arg.setName(params[i]->name.get());
-    llvm::Value *const shadow = generate_vardecl(*params[i]);
-    Builder.CreateStore(&arg, shadow);
+    if (is_ssa(*params[i])) {
+      write_variable(*params[i], bb2, &arg);
+      debug_value(*params[i], &arg);
+    } else
+      Builder.CreateStore(&arg, generate_vardecl(*params[i]));
     i++;
   }
 
+  // Self-recursive calls in tail position are turned into a loop
+  // starting after the parameters have been stored.
+  tail_calls.clear();
+  find_tail_calls(decl.get_expr().get());
+  tail_entry = nullptr;
+  for (auto call : tail_calls) {
+    if (&call->get_decl().get() == &decl) {
+      tail_entry = llvm::BasicBlock::Create(Context, "tail_entry", current_function);
+      Builder.CreateBr(tail_entry);
+      Builder.SetInsertPoint(tail_entry);
+      break;
+    }
+  }
+
   // Visit the body
   llvm::Value *expr = decl.get_expr()->accept(*this);
 
@@ -113,23 +255,64 @@ void IRGenerator::generate_function(const FunDecl &decl) {
   else
     Builder.CreateRet(expr);
 
+  // All the self tail calls are known now.
+  if (tail_entry)
+    seal_block(tail_entry);
+
   // Jump from entry to body
   Builder.SetInsertPoint(bb1);
   Builder.CreateBr(bb2);
 
+#if LLVM_VERSION_MAJOR >= 5
+  // The variables of the function are all known, its debug
+  // information can be completed before verification.
+  if (DBuilder)
+    DBuilder->finalizeSubprogram(debug_subprogram);
+#endif // LLVM_VERSION_MAJOR >= 5
+
   // Validate the generated code, checking for consistency.
-  llvm::verifyFunction(*current_function);
+  if (verify && llvm::verifyFunction(*current_function, &llvm::errs()))
+    error("invalid IR generated for " + decl.get_external_name().get());
+}
+
+void IRGenerator::find_tail_calls(const Expr &expr) {
+  if (auto seq = dynamic_cast<const Sequence *>(&expr)) {
+    if (!seq->get_exprs().empty())
+      find_tail_calls(*seq->get_exprs().back());
+  } else if (auto let = dynamic_cast<const Let *>(&expr)) {
+    find_tail_calls(let->get_sequence());
+  } else if (auto ite = dynamic_cast<const IfThenElse *>(&expr)) {
+    find_tail_calls(ite->get_then_part());
+    find_tail_calls(ite->get_else_part());
+  } else if (auto call = dynamic_cast<const FunCall *>(&expr)) {
+    tail_calls.insert(call);
+  }
+}
+
+llvm::Value *IRGenerator::continue_after_tail_call(const ast::Type type) {
+  // Like after a break, following code is unreachable.
+  llvm::BasicBlock *const after_call =
+      llvm::BasicBlock::Create(Context, "tail_call_deprecated", current_function);
+  Builder.SetInsertPoint(after_call);
+  seal_block(after_call);
+  if (type == t_void)
+    return nullptr;
+  return llvm::UndefValue::get(llvm_type(type));
 }
 
 void IRGenerator::generate_frame() {
   std::vector<llvm::Type*> escaping_types;
 
-  if (current_function_decl->get_parent()) {
+  if (current_function_decl->get_stores_static_link()) {
     llvm::PointerType *parent_frame = frame_type[&current_function_decl->get_parent().get()]->getPointerTo();
     escaping_types.push_back(parent_frame);
   }
 
+  // Void variables hold no value and get no slot.
   for (auto esc : current_function_decl->get_escaping_decls()) {
+    if (esc->get_type() == t_void)
+      continue;
+    frame_position[esc] = escaping_types.size();
     escaping_types.push_back(llvm_type(esc->get_type()));
   }
 
@@ -137,50 +320,49 @@ void IRGenerator::generate_frame() {
     llvm::StructType::create(Context, escaping_types, "ft_" + current_function_decl->get_external_name().get());
 
   frame_type[current_function_decl] = frame_structure;
-  frame = alloca_in_entry(frame_structure, "frame");
+
+  // No frame is needed if nothing would ever be stored into it.
+  frame = escaping_types.empty() ? nullptr : alloca_in_entry(frame_structure, "frame");
 }
 
 std::pair<llvm::StructType *, llvm::Value *> IRGenerator::frame_up(int levels) {
   FunDecl const* fun = current_function_decl;
-  llvm::Value *sl = frame;
-
-  for (int i = 0; i < levels; i++) {
+  for (int i = 0; i < levels; i++)
     fun = &fun->get_parent().get();
-    sl = Builder.CreateLoad(Builder.CreateStructGEP(sl, 0));
-  }
 
-  std::pair<llvm::StructType *, llvm::Value *> frame_info(frame_type[fun], sl);
+  std::pair<llvm::StructType *, llvm::Value *> frame_info(frame_type[fun],
+                                                          outer_frame(levels));
   return frame_info;
 }
 
-llvm::Value *IRGenerator::generate_vardecl(const VarDecl &decl) {
-  if (decl.get_escapes()) {
-    int pos = 0;
-
-    if (current_function_decl->get_parent()) {
-      pos++;
-    }
-    for (auto esc : current_function_decl->get_escaping_decls()) {
-      if (esc == &decl)
-        break;
-      if (esc->get_type() == t_void)
-        continue;
-      pos++;
-    }
-    frame_position[&decl] = pos;
-
-    llvm::Value *decl_address = Builder.CreateStructGEP(frame, pos);
-    allocations[&decl] = decl_address;
-    return decl_address;
-  }
-  else {
-    llvm::Value *decl_address = alloca_in_entry(llvm_type(decl.get_type()), decl.name);
-    allocations[&decl] = decl_address;
-    return decl_address;
-  }
+llvm::Value *IRGenerator::outer_frame(int levels) {
+  // The first level is the static link itself, the following ones
+  // are found in the frames of the enclosing functions.
+  if (levels == 0)
+    return frame;
+  if (levels == 1)
+    return static_link;
+  auto cached = outer_frames.find(levels);
+  if (cached != outer_frames.end())
+    return cached->second;
+
+  // The static links stored in the enclosing frames never change, and
+  // the entry block dominates every use.
+  llvm::Value *const inner = outer_frame(levels - 1);
+  llvm::IRBuilderBase::InsertPoint const saved = Builder.saveIP();
+  Builder.SetInsertPoint(&current_function->getEntryBlock());
+  llvm::Value *const outer = Builder.CreateLoad(
+      Builder.CreateStructGEP(inner, 0), "sl" + std::to_string(levels));
+  Builder.restoreIP(saved);
+  outer_frames[levels] = outer;
+  return outer;
 }
 
-
-
+llvm::Value *IRGenerator::generate_vardecl(const VarDecl &decl) {
+  llvm::Value *decl_address = Builder.CreateStructGEP(frame, frame_position[&decl]);
+  allocations[&decl] = decl_address;
+  debug_declare(decl, decl_address);
+  return decl_address;
+}
 
 } // namespace irgen
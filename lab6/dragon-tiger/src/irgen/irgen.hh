@@ -2,17 +2,48 @@
 #define IRGEN_HH
 
 #include <deque>
-#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "../ast/nodes.hh"
+#include "../ast/primitives.hh"
 
+#include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Support/raw_ostream.h"
 
 namespace irgen {
 using namespace ast::types;
 
+// Options of the optimizer and code generator.
+struct BackendOptions {
+  // Number of partitions optimized and compiled in parallel.
+  unsigned jobs = 1;
+  // Optimization level from 0 to 3, and size level (1 for -Os).
+  unsigned opt_level = 3;
+  unsigned size_level = 0;
+  // Explicit pipeline, in the syntax of opt -passes, replacing the
+  // pipeline of the optimization level.
+  std::string passes;
+  // Verify the module before optimization and after.
+  bool verify = false;
+  // Target CPU, and features in the syntax of llc -mattr. They apply
+  // to the generated functions and to the linked runtime alike.
+  std::string cpu = "generic";
+  std::string features;
+
+  // Target the CPU of the host with all its features.
+  void target_host();
+  // Raw profile written by the instrumented program, if any.
+  std::string profile_generate;
+  // Indexed profile used to optimize the program, if any.
+  std::string profile_use;
+};
+
 class IRGenerator : public ConstASTValueVisitor {
   // Hold the core "global" data of LLVM's core infrastructure,
   // including the type and constant uniquing tables.
@@ -24,19 +55,57 @@ class IRGenerator : public ConstASTValueVisitor {
   // Module generated by this tiger program compilation.
   std::unique_ptr<llvm::Module> Mod;
 
+  // Whether each generated function is verified.
+  bool verify;
+
   // Current function being generated.
   llvm::Function *current_function;
   const FunDecl *current_function_decl;
 
-  // Map variable declarations (including function parameters)
-  // to LLVM values. Those values might refer to the current
-  // function frame if they are escaping, or to
-  // alloca-declared variables if they are not escaping.
-  std::map<const VarDecl *, llvm::Value *> allocations;
+  // Map escaping variable declarations (including function
+  // parameters) to their address in the current function frame.
+  std::unordered_map<const VarDecl *, llvm::Value *> allocations;
+
+  // Map non-escaping loop indexes to the SSA value holding them.
+  // Those are read-only, so they need no storage.
+  std::unordered_map<const VarDecl *, llvm::Value *> ssa_values;
+
+  // Other non-escaping variables are kept in SSA form as well, built
+  // on the fly. current_def holds the value of each variable at the
+  // end of each block. A block is sealed once all its predecessors are
+  // known, until then reading a variable defined in a predecessor
+  // creates a phi which is completed when the block is sealed. The
+  // definitions follow the replacement of the phis found trivial.
+  std::unordered_map<
+      llvm::BasicBlock *,
+      std::unordered_map<const VarDecl *, llvm::TrackingVH<llvm::Value>>>
+      current_def;
+  std::unordered_set<llvm::BasicBlock *> sealed_blocks;
+  // Incomplete phis are kept in creation order so that the generated
+  // code does not depend on pointer values.
+  std::unordered_map<llvm::BasicBlock *,
+                     std::vector<std::pair<const VarDecl *, llvm::PHINode *>>>
+      incomplete_phis;
+
+  void write_variable(const VarDecl &, llvm::BasicBlock *, llvm::Value *);
+  llvm::Value *read_variable(const VarDecl &, llvm::BasicBlock *);
+  llvm::Value *read_variable_recursive(const VarDecl &, llvm::BasicBlock *);
+  llvm::PHINode *new_phi(const VarDecl &, llvm::BasicBlock *);
+  llvm::Value *add_phi_operands(const VarDecl &, llvm::PHINode *);
+  llvm::Value *try_remove_trivial_phi(llvm::PHINode *);
+  void seal_block(llvm::BasicBlock *);
+
+  // Return whether a variable is kept in SSA form rather than in the
+  // frame.
+  bool is_ssa(const VarDecl &decl) const { return !decl.get_escapes(); }
+
+  // Map string literals to the pointer to their global constant,
+  // so that each distinct literal is emitted once in the module.
+  std::unordered_map<utils::Symbol, llvm::Value *> string_constants;
 
   // Map loops to their exit blocks, so that early exits can
   // be easily processed.
-  std::map<const Loop *, llvm::BasicBlock *> loop_exit_bbs;
+  std::unordered_map<const Loop *, llvm::BasicBlock *> loop_exit_bbs;
 
   // List of functions to be processed after the current one.
   // This is necessary because in Tiger we might encounter
@@ -46,30 +115,101 @@ class IRGenerator : public ConstASTValueVisitor {
   // generation before handling the next one.
   std::deque<const FunDecl *> pending_func_bodies;
 
-  // Map escaping variables to their position into the current
-  // function frame.
-  std::map<const VarDecl *, int> frame_position;
+  // Map escaping variables to their position into the frame of
+  // their function, assigned when the frame type is generated.
+  std::unordered_map<const VarDecl *, int> frame_position;
 
   // Map function declarations to their specific frame types.
-  std::map<const FunDecl *, llvm::StructType *> frame_type;
+  std::unordered_map<const FunDecl *, llvm::StructType *> frame_type;
 
-  // Frame of the current function.
+  // Frame of the current function, or nullptr if the function
+  // has neither escaping variables nor a static link to keep.
   llvm::Value *frame;
 
+  // Static link received by the current function, or nullptr if
+  // the function never accesses its enclosing frames.
+  llvm::Value *static_link;
+
+  // Frames of the enclosing functions two levels up or more, indexed
+  // by level. Each is loaded once in the entry block of the current
+  // function, so that outer variables are reached without walking the
+  // chain of static links at each access.
+  std::unordered_map<int, llvm::Value *> outer_frames;
+
+  // Calls in tail position in the current function. Self-calls among
+  // them jump back to tail_entry after updating the parameters, the
+  // others are marked as tail calls.
+  std::unordered_set<const FunCall *> tail_calls;
+  llvm::BasicBlock *tail_entry;
+
+  // Collect the calls found in tail position in an expression, that
+  // is the last expression of a sequence or let, or either branch of a
+  // conditional.
+  void find_tail_calls(const Expr &);
+
+  // Continue in an unreachable block after a tail call which left the
+  // current code, and return a placeholder for the call value.
+  llvm::Value *continue_after_tail_call(const ast::Type);
+
   // Generate the LLVM IR code corresponding to a function
   // declaration. If inner function declarations are encountered,
   // they will be stored into pending_func_bodies for later
   // processing.
   void generate_function(const FunDecl &);
 
+  // Debug information, only generated once enabled. Frame slots are
+  // described by llvm.dbg.declare, and the values of SSA variables by
+  // llvm.dbg.value at each assignment.
+  std::unique_ptr<llvm::DIBuilder> DBuilder;
+  llvm::DIFile *debug_file;
+  llvm::DISubprogram *debug_subprogram;
+  std::unordered_map<const VarDecl *, llvm::DILocalVariable *> debug_variables;
+
+  llvm::DIType *debug_type(const ast::Type);
+  void debug_function(const FunDecl &, llvm::Function *);
+  llvm::DILocalVariable *debug_variable(const VarDecl &);
+  void debug_declare(const VarDecl &, llvm::Value *address);
+  void debug_value(const VarDecl &, llvm::Value *value);
+
+  // Give the instructions generated during the lifetime of this object
+  // the location of a node, then restore the previous one, so that an
+  // expression gets its location back after visiting its operands.
+  class LocationScope {
+    IRGenerator &generator;
+    llvm::DebugLoc saved;
+
+  public:
+    LocationScope(IRGenerator &, const Node &);
+    ~LocationScope();
+  };
+
+  // Open an output file, "-" designating the standard output.
+  static std::unique_ptr<llvm::raw_fd_ostream>
+  open_output(const std::string &filename, bool text);
+
   // Return the LLVM type corresponding to a Tiger type.
   llvm::Type *llvm_type(const ast::Type);
 
+  // Declare the runtime function implementing a primitive, with the
+  // attributes matching its description, or return the existing
+  // declaration. These attributes only reach the optimizer when the
+  // runtime is not linked into the module, as with --dump-ir or
+  // --emit-bc without --runtime. Otherwise link_runtime replaces the
+  // declarations by the definitions, whose attributes are inferred
+  // from their code.
+  llvm::Function *declare_primitive(const ast::primitives::Primitive &);
+
   // Generate a new alloca in the entry block of the function
   // for a variable of a given type. A name hint can be given,
   // otherwise automatic naming (%0, %1, etc.) will be used.
   llvm::Value *alloca_in_entry(llvm::Type *Ty, const std::string &name = "");
 
+  // Branch to one of two blocks depending on whether an integer
+  // condition is nonzero. Logical operators are lowered directly
+  // into branches instead of computing their value.
+  void generate_condition(const Expr &, llvm::BasicBlock *if_true,
+                          llvm::BasicBlock *if_false);
+
   // Return the address of a given identifier.
   llvm::Value *address_of(const Identifier &id);
 
@@ -83,21 +223,49 @@ class IRGenerator : public ConstASTValueVisitor {
   // access it.
   std::pair<llvm::StructType *, llvm::Value *> frame_up(int levels);
 
-  // Returns IR equivalent values to variable declarations through
-  // either allocating them in the entry basic block of a function
-  // or finding their position in the function's frame
+  // Return the frame of the function a given number of levels above
+  // the current one.
+  llvm::Value *outer_frame(int levels);
+
+  // Returns the address of an escaping variable declaration in the
+  // current function frame.
   llvm::Value * generate_vardecl(const VarDecl &decl);
 
 public:
   // Constructor
   IRGenerator();
 
+  // Generate debug information for the given source file, which must
+  // be enabled before generating the program.
+  void enable_debug_info(const std::string &filename);
+
+  // Verify each function once generated, failing on invalid IR.
+  void enable_verification() { verify = true; }
+
   // Given the main function declaration, generate the LLVM IR
   // corresponding to the whole program.
   void generate_program(FunDecl *);
 
-  // Print the generated IR.
-  void print_ir(std::ostream *);
+  // Print the generated IR, or write it as bitcode, into a file.
+  // "-" designates the standard output.
+  void print_ir(const std::string &filename);
+  void emit_bitcode(const std::string &filename);
+
+  // Link the runtime functions used by the program from a bitcode
+  // file, as internal functions which the optimizer can inline. The
+  // linked definitions keep their own attributes, not those of the
+  // primitive registry.
+  void link_runtime(const std::string &filename);
+
+  // Make every function defined in the module, including the ones of
+  // the runtime, use the target CPU and features of the options, so
+  // that they can be inlined into each other.
+  void set_target_attributes(const BackendOptions &);
+
+  // Optimize the module and write it as object code. With several
+  // jobs, the module is split into as many partitions, optimized and
+  // compiled in parallel, and partition i is written to filename.i.
+  void emit_objects(const std::string &filename, const BackendOptions &);
 
   // Generate the IR corresponding to those AST nodes.
   // Those methods will return either nullptr when no
@@ -183,15 +183,8 @@ opExpr: expr PLUS expr   { $$ = new BinaryOperator(@2, $1, $3, o_plus); }
       | expr GT expr     { $$ = new BinaryOperator(@2, $1, $3, o_gt); }
       | expr LE expr     { $$ = new BinaryOperator(@2, $1, $3, o_le); }
       | expr GE expr     { $$ = new BinaryOperator(@2, $1, $3, o_ge); }
-      | expr AND expr    {
-        $$ = new IfThenElse(@2, $1,
-                            new IfThenElse(@3, $3, new IntegerLiteral(nl, 1), new IntegerLiteral(nl, 0)),
-                            new IntegerLiteral(nl, 0));
-      }
-      | expr OR expr     {
-        $$ = new IfThenElse(@2, $1, new IntegerLiteral(nl, 1),
-                            new IfThenElse(@3, $3, new IntegerLiteral(nl, 1), new IntegerLiteral(nl, 0)));
-      }
+      | expr AND expr    { $$ = new BinaryOperator(@2, $1, $3, o_and); }
+      | expr OR expr     { $$ = new BinaryOperator(@2, $1, $3, o_or); }
 ;
 
 
@@ -55,10 +55,11 @@ const char *__chr(int32_t i) {
   if (i < 0 || i > 255) {
     error("chr: character out of range");
   }
-  char *s = (char*) malloc(MB_CUR_MAX*sizeof(char));
+  char *s = (char*) malloc((MB_CUR_MAX+1)*sizeof(char));
   setlocale(LC_CTYPE, "");
   wchar_t wc = i;
-  wcrtomb(s, wc, NULL);
+  size_t length = wcrtomb(s, wc, NULL);
+  s[length == (size_t) -1 ? 0 : length] = '\0';
   return s;
 }
 
@@ -75,15 +76,17 @@ const char *__substring(const char *s, int32_t first, int32_t length) {
   if (strlen(s) < first || strlen(s) - first < length) {
     error("substring: requested substring out of bounds");
   }
-  char* str = (char*) malloc(length*sizeof(char));
-  strncpy(str, &s[first], length);
+  char* str = (char*) malloc((length+1)*sizeof(char));
+  memcpy(str, &s[first], length);
+  str[length] = '\0';
   return str;
 }
 
 const char *__concat(const char *s1, const char *s2) {
-  char* s = (char*) malloc((strlen(s1)+strlen(s2))*sizeof(char));
-  strcat(s, s1);
-  strcat(s, s2);
+  const size_t l1 = strlen(s1), l2 = strlen(s2);
+  char* s = (char*) malloc((l1+l2+1)*sizeof(char));
+  memcpy(s, s1, l1);
+  memcpy(s + l1, s2, l2 + 1);
   return s;
 }
 
@@ -114,5 +117,7 @@ int32_t __not(int32_t i) {
 }
 
 void __exit(int32_t c) {
+  /* Unlike _exit, exit runs the atexit handlers, which flush the
+     output and write the profile of instrumented programs. */
   exit(c);
 }
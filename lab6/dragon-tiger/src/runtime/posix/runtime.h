@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 
+// The compiler describes those functions in src/ast/primitives.cc,
+// which must be updated along with this file.
+
 // Print a null-terminated string on standard error.
 void __print_err(const char *s);
 